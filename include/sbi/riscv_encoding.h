@@ -103,6 +103,8 @@
 #define SIP_SSIP			MIP_SSIP
 #define SIP_STIP			MIP_STIP
 
+#define ENVCFG_STCE			(_ULL(1) << 63)
+
 #define PRV_U				_UL(0)
 #define PRV_S				_UL(1)
 #define PRV_M				_UL(3)
@@ -299,6 +301,8 @@
 #define CSR_SCAUSE			0x142
 #define CSR_STVAL			0x143
 #define CSR_SIP				0x144
+#define CSR_STIMECMP			0x14d
+#define CSR_STIMECMPH			0x15d
 
 /* Supervisor Protection and Translation */
 #define CSR_SATP			0x180
@@ -356,6 +360,10 @@
 #define CSR_MCOUNTEREN			0x306
 #define CSR_MSTATUSH			0x310
 
+/* Machine Configuration */
+#define CSR_MENVCFG			0x30a
+#define CSR_MENVCFGH			0x31a
+
 /* Machine Trap Handling */
 #define CSR_MSCRATCH			0x340
 #define CSR_MEPC			0x341
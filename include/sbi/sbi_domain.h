@@ -53,6 +53,26 @@ struct sbi_domain_memregion {
 /** Maximum number of domains */
 #define SBI_DOMAIN_MAX_INDEX			32
 
+/** Maximum number of PMP entries in the PMP image of a domain */
+#define SBI_DOMAIN_PMP_MAX			64
+
+/** PMP CSR values enforcing the memory regions of a domain */
+struct sbi_domain_pmp_image {
+	/**
+	 * Number of PMP entries of the HARTs the image was built for,
+	 * all of them are covered (zero if not usable)
+	 */
+	unsigned int count;
+	/** PMP granularity (log2) of the HARTs the image was built for */
+	unsigned int gran_log2;
+	/** PMP address bits of the HARTs the image was built for */
+	unsigned int addr_bits;
+	/** Packed pmpcfg CSR values */
+	unsigned long cfg[SBI_DOMAIN_PMP_MAX / (__riscv_xlen / 8)];
+	/** pmpaddr CSR values */
+	unsigned long addr[SBI_DOMAIN_PMP_MAX];
+};
+
 /** Representation of OpenSBI domain */
 struct sbi_domain {
 	/**
@@ -82,6 +102,11 @@ struct sbi_domain {
 	unsigned long next_mode;
 	/** Is domain allowed to reset the system */
 	bool system_reset_allowed;
+	/**
+	 * PMP CSR values of this domain
+	 * Note: This set by sbi_domain_finalize() in the coldboot path
+	 */
+	struct sbi_domain_pmp_image pmp_image;
 };
 
 /** The root domain instance */
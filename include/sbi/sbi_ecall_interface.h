@@ -100,6 +100,8 @@
 #define SBI_EXT_PMU_COUNTER_STOP	0x4
 #define SBI_EXT_PMU_COUNTER_FW_READ	0x5
 
+#ifndef __ASSEMBLER__
+
 /** General pmu event codes specified in SBI PMU extension */
 enum sbi_pmu_hw_generic_events_t {
 	SBI_PMU_HW_NO_EVENT			= 0,
@@ -182,6 +184,15 @@ enum sbi_pmu_fw_event_code_id {
 	SBI_PMU_FW_HFENCE_VVMA_ASID_SENT = 20,
 	SBI_PMU_FW_HFENCE_VVMA_ASID_RCVD = 21,
 	SBI_PMU_FW_MAX,
+
+	/* Event codes 256 to 65534 are SBI implementation specific */
+	SBI_PMU_FW_IMPL_BASE		= 256,
+	/* M-mode cycles filtered by the event data given at config time */
+	SBI_PMU_FW_TRAP_CYCLES		= SBI_PMU_FW_IMPL_BASE + 0,
+	SBI_PMU_FW_ECALL_CYCLES		= SBI_PMU_FW_IMPL_BASE + 1,
+	SBI_PMU_FW_IPI_CYCLES		= SBI_PMU_FW_IMPL_BASE + 2,
+	SBI_PMU_FW_IPI_DOORBELL_SKIPPED	= SBI_PMU_FW_IMPL_BASE + 3,
+	SBI_PMU_FW_IMPL_MAX,
 };
 
 /** SBI PMU event idx type */
@@ -199,6 +210,8 @@ enum sbi_pmu_ctr_type {
 	SBI_PMU_CTR_TYPE_FW,
 };
 
+#endif
+
 /* Helper macros to decode event idx */
 #define SBI_PMU_EVENT_IDX_OFFSET 20
 #define SBI_PMU_EVENT_IDX_MASK 0xFFFFF
@@ -24,12 +24,17 @@ enum sbi_hart_features {
 	SBI_HART_HAS_SSCOFPMF = (1 << 3),
 	/** HART has timer csr implementation in hardware */
 	SBI_HART_HAS_TIME = (1 << 4),
+	/** HART has supervisor timer compare (Sstc) extension */
+	SBI_HART_HAS_SSTC = (1 << 5),
+	/** HART has fine-grained address translation cache invalidation */
+	SBI_HART_HAS_SVINVAL = (1 << 6),
 
 	/** Last index of Hart features*/
-	SBI_HART_HAS_LAST_FEATURE = SBI_HART_HAS_TIME,
+	SBI_HART_HAS_LAST_FEATURE = SBI_HART_HAS_SVINVAL,
 };
 
 struct sbi_scratch;
+struct sbi_domain;
 
 int sbi_hart_reinit(struct sbi_scratch *scratch);
 int sbi_hart_init(struct sbi_scratch *scratch, bool cold_boot);
@@ -47,6 +52,10 @@ unsigned int sbi_hart_pmp_count(struct sbi_scratch *scratch);
 unsigned long sbi_hart_pmp_granularity(struct sbi_scratch *scratch);
 unsigned int sbi_hart_pmp_addrbits(struct sbi_scratch *scratch);
 unsigned int sbi_hart_mhpm_bits(struct sbi_scratch *scratch);
+int sbi_hart_pmp_image_build(struct sbi_scratch *scratch,
+			     struct sbi_domain *dom);
+int sbi_hart_pmp_apply(struct sbi_scratch *scratch,
+		       const struct sbi_domain *dom);
 int sbi_hart_pmp_configure(struct sbi_scratch *scratch);
 void sbi_hart_blocker_fscr_configure(struct sbi_scratch *scratch);
 bool sbi_hart_has_feature(struct sbi_scratch *scratch, unsigned long feature);
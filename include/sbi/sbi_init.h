@@ -14,10 +14,41 @@
 
 struct sbi_scratch;
 
+/** Boot phases recorded for each HART, in coldboot order */
+enum sbi_boot_phase {
+	SBI_BOOT_PHASE_ENTRY = 0,
+	SBI_BOOT_PHASE_SCRATCH,
+	SBI_BOOT_PHASE_DOMAIN_INIT,
+	SBI_BOOT_PHASE_HSM,
+	SBI_BOOT_PHASE_EARLY_INIT,
+	SBI_BOOT_PHASE_HART,
+	SBI_BOOT_PHASE_CONSOLE,
+	SBI_BOOT_PHASE_PMU,
+	SBI_BOOT_PHASE_IRQCHIP,
+	SBI_BOOT_PHASE_IPI,
+	SBI_BOOT_PHASE_TLB,
+	SBI_BOOT_PHASE_TIMER,
+	SBI_BOOT_PHASE_ECALL,
+	SBI_BOOT_PHASE_DOMAIN_FINALIZE,
+	SBI_BOOT_PHASE_PMP,
+	SBI_BOOT_PHASE_FINAL_INIT,
+	SBI_BOOT_PHASE_NEXT_ENTRY,
+	SBI_BOOT_PHASE_MAX
+};
+
 void __noreturn sbi_init(struct sbi_scratch *scratch);
 
 unsigned long sbi_init_count(u32 hartid);
 
+/** Get name of a boot phase */
+const char *sbi_init_boot_phase_name(enum sbi_boot_phase phase);
+
+/**
+ * Get mcycle value of a HART at the end of a boot phase
+ * (0 if the HART did not reach it)
+ */
+u64 sbi_init_boot_phase_stamp(u32 hartid, enum sbi_boot_phase phase);
+
 void __noreturn sbi_exit(struct sbi_scratch *scratch);
 
 #endif
@@ -30,6 +30,7 @@ struct sbi_ipi_device {
 	void (*ipi_clear)(u32 target_hart);
 };
 
+struct sbi_hartmask;
 struct sbi_scratch;
 
 /** IPI event operations or callbacks */
@@ -47,9 +48,9 @@ struct sbi_ipi_event_ops {
 			u32 remote_hartid, void *data);
 
 	/**
-	 * Sync callback to wait for remote HART
-	 * Note: This is an optional callback and it is called just after
-	 * triggering IPI to remote HART.
+	 * Sync callback to wait for remote HARTs
+	 * Note: This is an optional callback and it is called once after
+	 * triggering IPIs to all remote HARTs.
 	 */
 	void (* sync)(struct sbi_scratch *scratch);
 
@@ -81,6 +82,16 @@ const struct sbi_ipi_device *sbi_ipi_get_device(void);
 
 void sbi_ipi_set_device(const struct sbi_ipi_device *dev);
 
+const struct sbi_ipi_device *sbi_ipi_get_smode_device(void);
+
+/**
+ * Set device which raises S-mode software interrupts directly for the
+ * given HARTs. Calling it again with the same device adds more HARTs.
+ * S-mode IPIs to other HARTs still go through the M-mode IPI device.
+ */
+void sbi_ipi_set_smode_device(const struct sbi_ipi_device *dev,
+			      const struct sbi_hartmask *harts);
+
 int sbi_ipi_init(struct sbi_scratch *scratch, bool cold_boot);
 
 void sbi_ipi_exit(struct sbi_scratch *scratch);
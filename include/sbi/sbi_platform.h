@@ -37,6 +37,11 @@
 #define SBI_PLATFORM_HART_INDEX2ID_OFFSET (0x58 + (__SIZEOF_POINTER__ * 2))
 
 #define SBI_PLATFORM_TLB_RANGE_FLUSH_LIMIT_DEFAULT		(1UL << 12)
+/**
+ * Range flush limit asking for boot time calibration. A limit of 0
+ * keeps its meaning of always doing a full flush.
+ */
+#define SBI_PLATFORM_TLB_RANGE_FLUSH_LIMIT_CALIBRATE		(~0ULL)
 
 #ifndef __ASSEMBLER__
 
@@ -53,9 +58,14 @@ struct sbi_trap_regs;
 enum sbi_platform_features {
 	/** Platform has fault delegation support */
 	SBI_PLATFORM_HAS_MFAULTS_DELEGATION = (1 << 1),
+	/**
+	 * Platform has HARTs with identical ID CSRs and misa but different
+	 * features so each HART must detect its own features
+	 */
+	SBI_PLATFORM_HAS_HETEROGENEOUS_HARTS = (1 << 2),
 
 	/** Last index of Platform features*/
-	SBI_PLATFORM_HAS_LAST_FEATURE = SBI_PLATFORM_HAS_MFAULTS_DELEGATION,
+	SBI_PLATFORM_HAS_LAST_FEATURE = SBI_PLATFORM_HAS_HETEROGENEOUS_HARTS,
 };
 
 /** Default feature set for a platform */
@@ -186,6 +196,10 @@ struct sbi_platform {
 #define sbi_platform_has_mfaults_delegation(__p) \
 	((__p)->features & SBI_PLATFORM_HAS_MFAULTS_DELEGATION)
 
+/** Check whether the platform needs per-HART feature detection */
+#define sbi_platform_has_heterogeneous_harts(__p) \
+	((__p)->features & SBI_PLATFORM_HAS_HETEROGENEOUS_HARTS)
+
 /**
  * Get HART index for the given HART
  *
@@ -244,7 +258,8 @@ static inline unsigned long sbi_platform_get_features(
  * @param plat pointer to struct sbi_platform
  *
  * @return tlb range flush limit value. Returns a default (page size) if not
- * defined by platform.
+ * defined by platform. SBI_PLATFORM_TLB_RANGE_FLUSH_LIMIT_CALIBRATE means
+ * that the limits are measured for each fence type at cold boot.
  */
 static inline u64 sbi_platform_tlbr_flush_limit(const struct sbi_platform *plat)
 {
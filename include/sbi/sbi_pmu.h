@@ -28,6 +28,17 @@
 #define SBI_PMU_CTR_MAX	   (SBI_PMU_HW_CTR_MAX + SBI_PMU_FW_CTR_MAX)
 #define SBI_PMU_FIXED_CTR_MASK 0x07
 
+/**
+ * Event data of the cycle profiling firmware events selects what is
+ * accounted by a counter:
+ * SBI_PMU_FW_TRAP_CYCLES  - mcause value
+ * SBI_PMU_FW_ECALL_CYCLES - extension ID in bits [63:32] and function
+ *                           ID in bits [31:0], each half may be ~0U
+ * SBI_PMU_FW_IPI_CYCLES   - IPI event number
+ * SBI_PMU_FW_PROF_ANY matches everything.
+ */
+#define SBI_PMU_FW_PROF_ANY	(~0ULL)
+
 /** Initialize PMU */
 int sbi_pmu_init(struct sbi_scratch *scratch, bool cold_boot);
 
@@ -71,4 +82,19 @@ int sbi_pmu_ctr_cfg_match(unsigned long cidx_base, unsigned long cidx_mask,
 
 int sbi_pmu_ctr_incr_fw(enum sbi_pmu_fw_event_code_id fw_id);
 
+/**
+ * Start measuring M-mode cycles for a cycle profiling firmware event
+ * @return start timestamp or 0 when no profiling counter is running
+ */
+unsigned long sbi_pmu_prof_begin(void);
+
+/**
+ * Account M-mode cycles since sbi_pmu_prof_begin()
+ * @param fw_id cycle profiling firmware event
+ * @param data event data matched against the counter filters
+ * @param start value returned by sbi_pmu_prof_begin()
+ */
+void sbi_pmu_prof_end(enum sbi_pmu_fw_event_code_id fw_id, uint64_t data,
+		      unsigned long start);
+
 #endif
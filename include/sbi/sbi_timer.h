@@ -30,6 +30,21 @@ struct sbi_timer_device {
 	void (*timer_event_stop)(void);
 };
 
+/** Maximum number of pending firmware timer events per HART */
+#define SBI_TIMER_EVENT_MAX	8
+
+/** Firmware timer event */
+struct sbi_timer_event {
+	/** Timer value at which the event expires */
+	u64 deadline;
+
+	/** Called from the M-mode timer interrupt after the deadline */
+	void (*callback)(struct sbi_timer_event *ev);
+
+	/** Private data of the event owner */
+	void *priv;
+};
+
 struct sbi_scratch;
 
 /** Generic delay loop of desired granularity */
@@ -69,6 +84,12 @@ void sbi_timer_event_start(u64 next_event);
 /** Process timer event for current HART */
 void sbi_timer_process(void);
 
+/** Queue firmware timer event on current HART */
+int sbi_timer_event_add(struct sbi_timer_event *ev, u64 deadline);
+
+/** Remove queued firmware timer event from current HART */
+int sbi_timer_event_del(struct sbi_timer_event *ev);
+
 /** Get current timer device */
 const struct sbi_timer_device *sbi_timer_get_device(void);
 
@@ -20,41 +20,63 @@
 
 /* clang-format on */
 
-#define SBI_TLB_FIFO_NUM_ENTRIES		8
-
 struct sbi_scratch;
 
+/** Address translation stage invalidated by a fence */
+enum sbi_tlb_fence_type {
+	SBI_TLB_FENCE_S = 0,
+	SBI_TLB_FENCE_VS,
+	SBI_TLB_FENCE_G,
+	SBI_TLB_FENCE_MAX
+};
+
+/** Kind of fence requested from remote HARTs */
+enum sbi_tlb_type {
+	SBI_TLB_TYPE_FENCE_I = 0,
+	SBI_TLB_SFENCE_VMA,
+	SBI_TLB_SFENCE_VMA_ASID,
+	SBI_TLB_HFENCE_GVMA_VMID,
+	SBI_TLB_HFENCE_GVMA,
+	SBI_TLB_HFENCE_VVMA_ASID,
+	SBI_TLB_HFENCE_VVMA,
+	SBI_TLB_TYPE_MAX
+};
+
+/**
+ * Fence request descriptor
+ *
+ * One descriptor lives in the scratch space of every HART, so it is
+ * kept compact: ASIDs and VMIDs are at most 16 bits wide and the
+ * sender is an index instead of a HART mask.
+ */
 struct sbi_tlb_info {
 	unsigned long start;
 	unsigned long size;
-	unsigned long asid;
-	unsigned long vmid;
-	void (*local_fn)(struct sbi_tlb_info *tinfo);
-	struct sbi_hartmask smask;
+	u16 asid;
+	u16 vmid;
+	u16 type;
+	u16 src_hart;
 };
 
-void sbi_tlb_local_hfence_vvma(struct sbi_tlb_info *tinfo);
-void sbi_tlb_local_hfence_gvma(struct sbi_tlb_info *tinfo);
-void sbi_tlb_local_sfence_vma(struct sbi_tlb_info *tinfo);
-void sbi_tlb_local_hfence_vvma_asid(struct sbi_tlb_info *tinfo);
-void sbi_tlb_local_hfence_gvma_vmid(struct sbi_tlb_info *tinfo);
-void sbi_tlb_local_sfence_vma_asid(struct sbi_tlb_info *tinfo);
-void sbi_tlb_local_fence_i(struct sbi_tlb_info *tinfo);
-
-#define SBI_TLB_INFO_INIT(__p, __start, __size, __asid, __vmid, __lfn, __src) \
+#define SBI_TLB_INFO_INIT(__p, __start, __size, __asid, __vmid, __type, __src) \
 do { \
 	(__p)->start = (__start); \
 	(__p)->size = (__size); \
 	(__p)->asid = (__asid); \
 	(__p)->vmid = (__vmid); \
-	(__p)->local_fn = (__lfn); \
-	SBI_HARTMASK_INIT_EXCEPT(&(__p)->smask, (__src)); \
+	(__p)->type = (__type); \
+	(__p)->src_hart = (__src); \
 } while (0)
 
 #define SBI_TLB_INFO_SIZE		sizeof(struct sbi_tlb_info)
 
 int sbi_tlb_request(ulong hmask, ulong hbase, struct sbi_tlb_info *tinfo);
 
+unsigned long sbi_tlb_range_flush_limit(enum sbi_tlb_fence_type type);
+
+void sbi_tlb_set_range_flush_limit(enum sbi_tlb_fence_type type,
+				   unsigned long limit);
+
 int sbi_tlb_init(struct sbi_scratch *scratch, bool cold_boot);
 
 #endif
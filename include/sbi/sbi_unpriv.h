@@ -36,6 +36,27 @@ DECLARE_UNPRIVILEGED_LOAD_FUNCTION(u64)
 DECLARE_UNPRIVILEGED_STORE_FUNCTION(u64)
 DECLARE_UNPRIVILEGED_LOAD_FUNCTION(ulong)
 
+/**
+ * Load up to sizeof(ulong) bytes from a possibly misaligned address
+ * using the largest naturally aligned accesses within one MPRV window
+ * @param addr unprivileged address to load from
+ * @param len number of bytes to load
+ * @param trap trap details in case of a fault
+ * @return loaded value zero extended from len bytes
+ */
+ulong sbi_load_bytes(ulong addr, ulong len, struct sbi_trap_info *trap);
+
+/**
+ * Store up to sizeof(ulong) bytes to a possibly misaligned address
+ * using the largest naturally aligned accesses within one MPRV window
+ * @param addr unprivileged address to store to
+ * @param val value whose lowest len bytes are stored
+ * @param len number of bytes to store
+ * @param trap trap details in case of a fault
+ */
+void sbi_store_bytes(ulong addr, ulong val, ulong len,
+		     struct sbi_trap_info *trap);
+
 ulong sbi_get_insn(ulong mepc, struct sbi_trap_info *trap);
 
 #endif
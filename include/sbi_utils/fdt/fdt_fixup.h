@@ -33,6 +33,19 @@ void fdt_cpu_fixup(void *fdt);
  */
 void fdt_plic_fixup(void *fdt);
 
+/**
+ * Fix up the ACLINT SSWI nodes in the device tree
+ *
+ * This routine sets the "status" property of every ACLINT SSWI node without
+ * the "opensbi,smode-access" property to "disabled" because OpenSBI protects
+ * such devices from S-mode.
+ *
+ * It is recommended that platform codes call this helper in their final_init()
+ *
+ * @param fdt: device tree blob
+ */
+void fdt_aclint_sswi_fixup(void *fdt);
+
 /**
  * Fix up the reserved memory node in the device tree
  *
@@ -60,6 +73,23 @@ int fdt_reserved_memory_fixup(void *fdt);
  */
 int fdt_reserved_memory_nomap_fixup(void *fdt);
 
+/**
+ * Fix up the chosen node with the boot phase trace
+ *
+ * This routine adds the "opensbi,boot-trace-phases" string list naming each
+ * boot phase and the "opensbi,boot-trace" property to the chosen node. The
+ * latter holds the hartid of the coldboot HART followed by its 64-bit mcycle
+ * value at the end of each boot phase (0 if not reached).
+ *
+ * Other HARTs may still be booting when the fix-up runs so their traces are
+ * not exported. Phases completing after this fix-up (including platform
+ * final init) are not part of the device tree either.
+ *
+ * @param fdt: device tree blob
+ * @return zero on success and -ve on failure
+ */
+int fdt_boot_trace_fixup(void *fdt);
+
 /**
  * General device tree fix-up
  *
@@ -47,12 +47,22 @@ int fdt_parse_phandle_with_args(void *fdt, int nodeoff,
 int fdt_get_node_addr_size(void *fdt, int node, int index,
 			   uint64_t *addr, uint64_t *size);
 
+bool fdt_node_is_enabled(void *fdt, int nodeoff);
+
 int fdt_parse_hart_id(void *fdt, int cpu_offset, u32 *hartid);
 
 int fdt_parse_max_hart_id(void *fdt, u32 *max_hartid);
 
+struct die_topology;
+
+int fdt_parse_die_topology(void *fdt, u32 first_die, u32 harts_per_die,
+			   struct die_topology *topo);
+
 int fdt_parse_timebase_frequency(void *fdt, unsigned long *freq);
 
+int fdt_parse_tlb_range_flush_limits(void *fdt, unsigned long *limits,
+				     u32 count);
+
 int fdt_parse_gaisler_uart_node(void *fdt, int nodeoffset,
 				struct platform_uart_data *uart);
 
@@ -79,6 +89,11 @@ int fdt_parse_aclint_node(void *fdt, int nodeoffset, bool for_timer,
 			  unsigned long *out_addr2, unsigned long *out_size2,
 			  u32 *out_first_hartid, u32 *out_hart_count);
 
+int fdt_parse_aclint_sswi_node(void *fdt, int nodeoffset,
+			       unsigned long *out_addr,
+			       unsigned long *out_size,
+			       u32 *out_first_hartid, u32 *out_hart_count);
+
 int fdt_parse_compat_addr(void *fdt, uint64_t *addr,
 			  const char *compatible);
 
@@ -18,12 +18,16 @@
 
 #define CLINT_MSWI_OFFSET		0x0000
 
+struct die_topology;
+
 struct aclint_mswi_data {
 	/* Public details */
 	unsigned long addr;
 	unsigned long size;
 	u32 first_hartid;
 	u32 hart_count;
+	/* Die layout of multi-die systems (NULL for a single die) */
+	const struct die_topology *topo;
 };
 
 int aclint_mswi_warm_init(void);
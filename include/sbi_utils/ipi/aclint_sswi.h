@@ -0,0 +1,31 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 Beijing ESWIN Computing Technology Co., Ltd.
+ */
+
+#ifndef __IPI_ACLINT_SSWI_H__
+#define __IPI_ACLINT_SSWI_H__
+
+#include <sbi/sbi_types.h>
+
+#define ACLINT_SSWI_ALIGN		0x1000
+#define ACLINT_SSWI_SIZE		0x4000
+#define ACLINT_SSWI_MAX_HARTS		4095
+
+struct aclint_sswi_data {
+	/* Public details */
+	unsigned long addr;
+	unsigned long size;
+	u32 first_hartid;
+	u32 hart_count;
+	/*
+	 * Leave the device accessible to S-mode. S-mode of any domain
+	 * can then raise IPIs on every HART covered by the device.
+	 */
+	bool smode_access;
+};
+
+int aclint_sswi_cold_init(struct aclint_sswi_data *sswi);
+
+#endif
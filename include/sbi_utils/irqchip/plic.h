@@ -12,9 +12,15 @@
 
 #include <sbi/sbi_types.h>
 
+struct die_topology;
+
 struct plic_data {
 	unsigned long addr;
 	unsigned long num_src;
+	/* Die layout of multi-die systems (NULL for a single die) */
+	const struct die_topology *topo;
+	/* Contexts of each die, context N lives on die N / die_context_count */
+	u32 die_context_count;
 };
 
 int plic_warm_irqchip_init(struct plic_data *plic,
@@ -0,0 +1,65 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 Beijing ESWIN Computing Technology Co., Ltd.
+ */
+
+#ifndef __SYS_DIE_TOPOLOGY_H__
+#define __SYS_DIE_TOPOLOGY_H__
+
+#include <sbi/sbi_bitops.h>
+#include <sbi/sbi_hartmask.h>
+
+#define DIE_TOPOLOGY_MAX_DIES		BITS_PER_LONG
+
+/**
+ * Multi-die system description shared by the ACLINT and PLIC drivers
+ *
+ * Every die carries its own copy of a device at the same offset from
+ * the die base, so the copy used by a HART is found by adding
+ * die_stride times the HART's die number to the device base address.
+ * Within a die, per-HART registers are indexed by the position of the
+ * HART among the HARTs of that die.
+ */
+struct die_topology {
+	/* Dies with at least one HART */
+	unsigned long die_mask;
+	/* MMIO offset between the same device on consecutive dies */
+	unsigned long die_stride;
+	/* Die of each HART */
+	u32 hartid2die[SBI_HARTMASK_MAX_BITS];
+	/* Position of each HART among the HARTs of its die */
+	u32 hartid2index[SBI_HARTMASK_MAX_BITS];
+};
+
+/** Dies having HARTs (only die 0 without topology) */
+static inline unsigned long die_topology_die_mask(
+					const struct die_topology *topo)
+{
+	return (topo) ? topo->die_mask : 1UL;
+}
+
+/** MMIO offset of the die with the given number */
+static inline unsigned long die_topology_die_offset(
+					const struct die_topology *topo,
+					u32 die)
+{
+	return (topo) ? die * topo->die_stride : 0;
+}
+
+/** MMIO offset of the die owning the given HART */
+static inline unsigned long die_topology_hart_offset(
+					const struct die_topology *topo,
+					u32 hartid)
+{
+	return (topo) ? topo->hartid2die[hartid] * topo->die_stride : 0;
+}
+
+/** Index of the given HART within the per-HART registers of its die */
+static inline u32 die_topology_hart_index(const struct die_topology *topo,
+					  u32 hartid, u32 first_hartid)
+{
+	return (topo) ? topo->hartid2index[hartid] : hartid - first_hartid;
+}
+
+#endif
@@ -22,6 +22,8 @@
 
 #define CLINT_MTIMER_OFFSET		0x4000
 
+struct die_topology;
+
 struct aclint_mtimer_data {
 	/* Public details */
 	unsigned long mtime_freq;
@@ -33,6 +35,8 @@ struct aclint_mtimer_data {
 	u32 hart_count;
 	bool has_64bit_mmio;
 	bool has_shared_mtime;
+	/* Die layout of multi-die systems (NULL for a single die) */
+	const struct die_topology *topo;
 	/* Private details (initialized and used by ACLINT MTIMER library) */
 	struct aclint_mtimer_data *time_delta_reference;
 	unsigned long time_delta_computed;
@@ -222,7 +222,7 @@ unsigned long atomic_raw_xchg_ulong(volatile unsigned long *ptr,
 				     : "=r"(__res), "+A"(addr[BIT_WORD(nr)]) \
 				     : "r"(mod(__mask))                      \
 				     : "memory");                            \
-		__res;                                                       \
+		(__res & __mask) ? 1 : 0;                                    \
 	})
 
 #define __atomic_op_bit(op, mod, nr, addr) \
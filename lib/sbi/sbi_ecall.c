@@ -11,6 +11,8 @@
 #include <sbi/sbi_ecall.h>
 #include <sbi/sbi_ecall_interface.h>
 #include <sbi/sbi_error.h>
+#include <sbi/sbi_pmu.h>
+#include <sbi/sbi_string.h>
 #include <sbi/sbi_trap.h>
 
 u16 sbi_ecall_version_major(void)
@@ -37,10 +39,89 @@ void sbi_ecall_set_impid(unsigned long impid)
 
 static SBI_LIST_HEAD(ecall_exts_list);
 
+/*
+ * Extensions covering only a few extension IDs are also entered into an
+ * open addressed hash table, one entry per extension ID, so that finding
+ * the extension of an ecall does not depend on the number of registered
+ * extensions. Wide ranges (such as vendor extensions) are only found by
+ * walking the extension list when the hash table lookup misses.
+ *
+ * Entries are inserted in registration order with linear probing hence
+ * the extensions registered first always sit in their home bucket and
+ * are found with a single probe.
+ */
+
+/* clang-format off */
+
+#define ECALL_HASH_SIZE			64
+#define ECALL_HASH_MAX_SPAN		16
+
+/* clang-format on */
+
+struct ecall_hash_entry {
+	unsigned long extid;
+	struct sbi_ecall_extension *ext;
+};
+
+static struct ecall_hash_entry ecall_hash_table[ECALL_HASH_SIZE];
+static unsigned long ecall_hash_count;
+
+static inline unsigned long ecall_hash(unsigned long extid)
+{
+	return (extid ^ (extid >> 8) ^ (extid >> 16) ^ (extid >> 24)) &
+		(ECALL_HASH_SIZE - 1);
+}
+
+static void ecall_hash_add(struct sbi_ecall_extension *ext)
+{
+	unsigned long extid, n, i, h;
+
+	if ((ext->extid_end - ext->extid_start) >= ECALL_HASH_MAX_SPAN)
+		return;
+
+	/* Keep the load factor low so that probe sequences stay short */
+	if ((ecall_hash_count + ext->extid_end - ext->extid_start + 1) >
+	    (ECALL_HASH_SIZE / 2))
+		return;
+
+	for (n = 0; n <= (ext->extid_end - ext->extid_start); n++) {
+		extid = ext->extid_start + n;
+		h = ecall_hash(extid);
+		for (i = 0; i < ECALL_HASH_SIZE; i++) {
+			if (!ecall_hash_table[h].ext)
+				break;
+			h = (h + 1) & (ECALL_HASH_SIZE - 1);
+		}
+		ecall_hash_table[h].extid = extid;
+		ecall_hash_table[h].ext = ext;
+		ecall_hash_count++;
+	}
+}
+
+static void ecall_hash_rebuild(void)
+{
+	struct sbi_ecall_extension *t;
+
+	sbi_memset(ecall_hash_table, 0, sizeof(ecall_hash_table));
+	ecall_hash_count = 0;
+
+	sbi_list_for_each_entry(t, &ecall_exts_list, head)
+		ecall_hash_add(t);
+}
+
 struct sbi_ecall_extension *sbi_ecall_find_extension(unsigned long extid)
 {
+	unsigned long i, h = ecall_hash(extid);
 	struct sbi_ecall_extension *t, *ret = NULL;
 
+	for (i = 0; i < ECALL_HASH_SIZE; i++) {
+		if (!ecall_hash_table[h].ext)
+			break;
+		if (ecall_hash_table[h].extid == extid)
+			return ecall_hash_table[h].ext;
+		h = (h + 1) & (ECALL_HASH_SIZE - 1);
+	}
+
 	sbi_list_for_each_entry(t, &ecall_exts_list, head) {
 		if (t->extid_start <= extid && extid <= t->extid_end) {
 			ret = t;
@@ -69,6 +150,7 @@ int sbi_ecall_register_extension(struct sbi_ecall_extension *ext)
 
 	SBI_INIT_LIST_HEAD(&ext->head);
 	sbi_list_add_tail(&ext->head, &ecall_exts_list);
+	ecall_hash_add(ext);
 
 	return 0;
 }
@@ -88,8 +170,10 @@ void sbi_ecall_unregister_extension(struct sbi_ecall_extension *ext)
 		}
 	}
 
-	if (found)
+	if (found) {
 		sbi_list_del_init(&ext->head);
+		ecall_hash_rebuild();
+	}
 }
 
 int sbi_ecall_handler(struct sbi_trap_regs *regs)
@@ -101,6 +185,7 @@ int sbi_ecall_handler(struct sbi_trap_regs *regs)
 	struct sbi_trap_info trap = {0};
 	unsigned long out_val = 0;
 	bool is_0_1_spec = 0;
+	unsigned long prof = sbi_pmu_prof_begin();
 
 	ext = sbi_ecall_find_extension(extension_id);
 	if (ext && ext->handle) {
@@ -138,6 +223,9 @@ int sbi_ecall_handler(struct sbi_trap_regs *regs)
 			regs->a1 = out_val;
 	}
 
+	sbi_pmu_prof_end(SBI_PMU_FW_ECALL_CYCLES,
+			 ((uint64_t)extension_id << 32) | (u32)func_id, prof);
+
 	return 0;
 }
 
@@ -145,7 +233,11 @@ int sbi_ecall_init(void)
 {
 	int ret;
 
-	/* The order of below registrations is performance optimized */
+	/*
+	 * The order of below registrations is performance optimized
+	 * because the first registered extensions get the dedicated
+	 * home buckets of the extension hash table.
+	 */
 	ret = sbi_ecall_register_extension(&ecall_time);
 	if (ret)
 		return ret;
@@ -18,35 +18,159 @@
 #include <sbi/sbi_timer.h>
 #include <sbi/sbi_trap.h>
 
-static bool hpm_allowed(int hpm_num, ulong prev_mode, bool virt)
+/** Per-HART counter permissions used by CSR emulation */
+struct csr_emul_hart {
+	/** Counters implemented on this HART */
+	unsigned long impl_mask;
+	/** Implemented counters which are also enabled in mcounteren */
+	unsigned long mcen_mask;
+	/** HART implements scounteren */
+	bool has_scounteren;
+};
+
+static unsigned long csr_emul_hart_off;
+
+typedef ulong (*counter_read_t)(bool virt);
+
+static ulong counter_read_cycle(bool virt)
 {
-	ulong cen = -1UL;
-	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
-
-	if (prev_mode <= PRV_S) {
-		if (sbi_hart_has_feature(scratch, SBI_HART_HAS_MCOUNTEREN)) {
-			cen &= csr_read(CSR_MCOUNTEREN);
-			if (virt)
-				cen &= csr_read(CSR_HCOUNTEREN);
-		} else {
-			cen = 0;
-		}
-	}
+	return csr_read(CSR_MCYCLE);
+}
+
+static ulong counter_read_time(bool virt)
+{
+	/*
+	 * We emulate TIME CSR for both Host (HS/U-mode) and
+	 * Guest (VS/VU-mode).
+	 */
+	return (virt) ? sbi_timer_virt_value() : sbi_timer_value();
+}
+
+static ulong counter_read_instret(bool virt)
+{
+	return csr_read(CSR_MINSTRET);
+}
+
+#define counter_read_hpm(__n)						\
+static ulong counter_read_hpm##__n(bool virt)				\
+{									\
+	return csr_read(CSR_MHPMCOUNTER##__n);				\
+}
+
+counter_read_hpm(3)  counter_read_hpm(4)  counter_read_hpm(5)
+counter_read_hpm(6)  counter_read_hpm(7)  counter_read_hpm(8)
+counter_read_hpm(9)  counter_read_hpm(10) counter_read_hpm(11)
+counter_read_hpm(12) counter_read_hpm(13) counter_read_hpm(14)
+counter_read_hpm(15) counter_read_hpm(16) counter_read_hpm(17)
+counter_read_hpm(18) counter_read_hpm(19) counter_read_hpm(20)
+counter_read_hpm(21) counter_read_hpm(22) counter_read_hpm(23)
+counter_read_hpm(24) counter_read_hpm(25) counter_read_hpm(26)
+counter_read_hpm(27) counter_read_hpm(28) counter_read_hpm(29)
+counter_read_hpm(30) counter_read_hpm(31)
+
+#undef counter_read_hpm
+
+#define COUNTER_HPM_ENTRIES(__p)					\
+	__p##3,  __p##4,  __p##5,  __p##6,  __p##7,  __p##8,		\
+	__p##9,  __p##10, __p##11, __p##12, __p##13, __p##14,		\
+	__p##15, __p##16, __p##17, __p##18, __p##19, __p##20,		\
+	__p##21, __p##22, __p##23, __p##24, __p##25, __p##26,		\
+	__p##27, __p##28, __p##29, __p##30, __p##31
+
+/* Read handlers indexed by (csr_num - CSR_CYCLE) */
+static const counter_read_t counter_read_table[32] = {
+	counter_read_cycle,
+	counter_read_time,
+	counter_read_instret,
+	COUNTER_HPM_ENTRIES(counter_read_hpm)
+};
+
+#if __riscv_xlen == 32
+static ulong counter_read_cycleh(bool virt)
+{
+	return csr_read(CSR_MCYCLEH);
+}
+
+static ulong counter_read_timeh(bool virt)
+{
+	/* Refer comments on TIME CSR above. */
+	return (virt) ? sbi_timer_virt_value() >> 32 :
+			sbi_timer_value() >> 32;
+}
+
+static ulong counter_read_instreth(bool virt)
+{
+	return csr_read(CSR_MINSTRETH);
+}
+
+#define counter_read_hpmh(__n)						\
+static ulong counter_read_hpmh##__n(bool virt)				\
+{									\
+	return csr_read(CSR_MHPMCOUNTER##__n##H);			\
+}
+
+counter_read_hpmh(3)  counter_read_hpmh(4)  counter_read_hpmh(5)
+counter_read_hpmh(6)  counter_read_hpmh(7)  counter_read_hpmh(8)
+counter_read_hpmh(9)  counter_read_hpmh(10) counter_read_hpmh(11)
+counter_read_hpmh(12) counter_read_hpmh(13) counter_read_hpmh(14)
+counter_read_hpmh(15) counter_read_hpmh(16) counter_read_hpmh(17)
+counter_read_hpmh(18) counter_read_hpmh(19) counter_read_hpmh(20)
+counter_read_hpmh(21) counter_read_hpmh(22) counter_read_hpmh(23)
+counter_read_hpmh(24) counter_read_hpmh(25) counter_read_hpmh(26)
+counter_read_hpmh(27) counter_read_hpmh(28) counter_read_hpmh(29)
+counter_read_hpmh(30) counter_read_hpmh(31)
+
+#undef counter_read_hpmh
+
+/* Read handlers indexed by (csr_num - CSR_CYCLEH) */
+static const counter_read_t counter_readh_table[32] = {
+	counter_read_cycleh,
+	counter_read_timeh,
+	counter_read_instreth,
+	COUNTER_HPM_ENTRIES(counter_read_hpmh)
+};
+#endif
+
+#undef COUNTER_HPM_ENTRIES
+
+static bool counter_allowed(int idx, ulong prev_mode, bool virt)
+{
+	ulong cen;
+	struct csr_emul_hart *ceh;
+
+	/*
+	 * Faster TIME CSR reads are critical for good performance
+	 * in S-mode software so we don't check CSR permissions.
+	 */
+	if (idx == (CSR_TIME - CSR_CYCLE))
+		return TRUE;
+
+	ceh = sbi_scratch_thishart_offset_ptr(csr_emul_hart_off);
+	if (prev_mode == PRV_M)
+		return ((ceh->impl_mask >> idx) & 1) ? TRUE : FALSE;
+
+	/*
+	 * The hcounteren and scounteren CSRs are written by lower
+	 * privilege modes without trapping so they are read here
+	 * instead of being folded into the per-HART mask.
+	 */
+	cen = ceh->mcen_mask;
+	if (virt && cen)
+		cen &= csr_read(CSR_HCOUNTEREN);
 	if (prev_mode == PRV_U) {
-		if (sbi_hart_has_feature(scratch, SBI_HART_HAS_SCOUNTEREN))
+		if (ceh->has_scounteren && cen)
 			cen &= csr_read(CSR_SCOUNTEREN);
 		else
 			cen = 0;
 	}
 
-	return ((cen >> hpm_num) & 1) ? TRUE : FALSE;
+	return ((cen >> idx) & 1) ? TRUE : FALSE;
 }
 
 int sbi_emulate_csr_read(int csr_num, struct sbi_trap_regs *regs,
 			 ulong *csr_val)
 {
 	int ret = 0;
-	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
 	ulong prev_mode = (regs->mstatus & MSTATUS_MPP) >> MSTATUS_MPP_SHIFT;
 #if __riscv_xlen == 32
 	bool virt = (regs->mstatusH & MSTATUSH_MPV) ? TRUE : FALSE;
@@ -54,6 +178,22 @@ int sbi_emulate_csr_read(int csr_num, struct sbi_trap_regs *regs,
 	bool virt = (regs->mstatus & MSTATUS_MPV) ? TRUE : FALSE;
 #endif
 
+	if (CSR_CYCLE <= csr_num && csr_num <= CSR_HPMCOUNTER31) {
+		if (!counter_allowed(csr_num - CSR_CYCLE, prev_mode, virt))
+			return SBI_ENOTSUPP;
+		*csr_val = counter_read_table[csr_num - CSR_CYCLE](virt);
+		return 0;
+	}
+
+#if __riscv_xlen == 32
+	if (CSR_CYCLEH <= csr_num && csr_num <= CSR_HPMCOUNTER31H) {
+		if (!counter_allowed(csr_num - CSR_CYCLEH, prev_mode, virt))
+			return SBI_ENOTSUPP;
+		*csr_val = counter_readh_table[csr_num - CSR_CYCLEH](virt);
+		return 0;
+	}
+#endif
+
 	switch (csr_num) {
 	case CSR_HTIMEDELTA:
 		if (prev_mode == PRV_S && !virt)
@@ -61,28 +201,6 @@ int sbi_emulate_csr_read(int csr_num, struct sbi_trap_regs *regs,
 		else
 			ret = SBI_ENOTSUPP;
 		break;
-	case CSR_CYCLE:
-		if (!hpm_allowed(csr_num - CSR_CYCLE, prev_mode, virt))
-			return SBI_ENOTSUPP;
-		*csr_val = csr_read(CSR_MCYCLE);
-		break;
-	case CSR_TIME:
-		/*
-		 * We emulate TIME CSR for both Host (HS/U-mode) and
-		 * Guest (VS/VU-mode).
-		 *
-		 * Faster TIME CSR reads are critical for good performance
-		 * in S-mode software so we don't check CSR permissions.
-		 */
-		*csr_val = (virt) ? sbi_timer_virt_value():
-				    sbi_timer_value();
-		break;
-	case CSR_INSTRET:
-		if (!hpm_allowed(csr_num - CSR_CYCLE, prev_mode, virt))
-			return SBI_ENOTSUPP;
-		*csr_val = csr_read(CSR_MINSTRET);
-		break;
-
 #if __riscv_xlen == 32
 	case CSR_HTIMEDELTAH:
 		if (prev_mode == PRV_S && !virt)
@@ -90,62 +208,7 @@ int sbi_emulate_csr_read(int csr_num, struct sbi_trap_regs *regs,
 		else
 			ret = SBI_ENOTSUPP;
 		break;
-	case CSR_CYCLEH:
-		if (!hpm_allowed(csr_num - CSR_CYCLEH, prev_mode, virt))
-			return SBI_ENOTSUPP;
-		*csr_val = csr_read(CSR_MCYCLEH);
-		break;
-	case CSR_TIMEH:
-		/* Refer comments on TIME CSR above. */
-		*csr_val = (virt) ? sbi_timer_virt_value() >> 32:
-				    sbi_timer_value() >> 32;
-		break;
-	case CSR_INSTRETH:
-		if (!hpm_allowed(csr_num - CSR_CYCLEH, prev_mode, virt))
-			return SBI_ENOTSUPP;
-		*csr_val = csr_read(CSR_MINSTRETH);
-		break;
 #endif
-
-#define switchcase_hpm(__uref, __mref, __csr)				\
-	case __csr:							\
-		if ((sbi_hart_mhpm_count(scratch) + 3) <= (__csr - __uref))\
-			return SBI_ENOTSUPP;				\
-		if (!hpm_allowed(__csr - __uref, prev_mode, virt))	\
-			return SBI_ENOTSUPP;				\
-		*csr_val = csr_read(__mref + __csr - __uref);		\
-		break;
-#define switchcase_hpm_2(__uref, __mref, __csr)			\
-	switchcase_hpm(__uref, __mref, __csr + 0)			\
-	switchcase_hpm(__uref, __mref, __csr + 1)
-#define switchcase_hpm_4(__uref, __mref, __csr)			\
-	switchcase_hpm_2(__uref, __mref, __csr + 0)			\
-	switchcase_hpm_2(__uref, __mref, __csr + 2)
-#define switchcase_hpm_8(__uref, __mref, __csr)			\
-	switchcase_hpm_4(__uref, __mref, __csr + 0)			\
-	switchcase_hpm_4(__uref, __mref, __csr + 4)
-#define switchcase_hpm_16(__uref, __mref, __csr)			\
-	switchcase_hpm_8(__uref, __mref, __csr + 0)			\
-	switchcase_hpm_8(__uref, __mref, __csr + 8)
-
-	switchcase_hpm(CSR_CYCLE, CSR_MCYCLE, CSR_HPMCOUNTER3)
-	switchcase_hpm_4(CSR_CYCLE, CSR_MCYCLE, CSR_HPMCOUNTER4)
-	switchcase_hpm_8(CSR_CYCLE, CSR_MCYCLE, CSR_HPMCOUNTER8)
-	switchcase_hpm_16(CSR_CYCLE, CSR_MCYCLE, CSR_HPMCOUNTER16)
-
-#if __riscv_xlen == 32
-	switchcase_hpm(CSR_CYCLEH, CSR_MCYCLEH, CSR_HPMCOUNTER3H)
-	switchcase_hpm_4(CSR_CYCLEH, CSR_MCYCLEH, CSR_HPMCOUNTER4H)
-	switchcase_hpm_8(CSR_CYCLEH, CSR_MCYCLEH, CSR_HPMCOUNTER8H)
-	switchcase_hpm_16(CSR_CYCLEH, CSR_MCYCLEH, CSR_HPMCOUNTER16H)
-#endif
-
-#undef switchcase_hpm_16
-#undef switchcase_hpm_8
-#undef switchcase_hpm_4
-#undef switchcase_hpm_2
-#undef switchcase_hpm
-
 	default:
 		ret = SBI_ENOTSUPP;
 		break;
@@ -195,3 +258,43 @@ int sbi_emulate_csr_write(int csr_num, struct sbi_trap_regs *regs,
 
 	return ret;
 }
+
+void sbi_emulate_csr_update(struct sbi_scratch *scratch)
+{
+	struct csr_emul_hart *ceh;
+	unsigned int mhpm_count;
+
+	if (!csr_emul_hart_off)
+		return;
+
+	ceh = sbi_scratch_offset_ptr(scratch, csr_emul_hart_off);
+
+	/* CYCLE, TIME and INSTRET followed by the implemented HPMs */
+	mhpm_count = sbi_hart_mhpm_count(scratch);
+	ceh->impl_mask = 0x7UL;
+	if (mhpm_count)
+		ceh->impl_mask |= ((1UL << mhpm_count) - 1) << 3;
+
+	if (sbi_hart_has_feature(scratch, SBI_HART_HAS_MCOUNTEREN))
+		ceh->mcen_mask = ceh->impl_mask & csr_read(CSR_MCOUNTEREN);
+	else
+		ceh->mcen_mask = 0;
+
+	ceh->has_scounteren = sbi_hart_has_feature(scratch,
+						   SBI_HART_HAS_SCOUNTEREN);
+}
+
+int sbi_emulate_csr_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	if (cold_boot) {
+		csr_emul_hart_off = sbi_scratch_alloc_offset(
+					sizeof(struct csr_emul_hart));
+		if (!csr_emul_hart_off)
+			return SBI_ENOMEM;
+	} else {
+		if (!csr_emul_hart_off)
+			return SBI_ENOMEM;
+	}
+
+	return 0;
+}
@@ -11,10 +11,12 @@
 #include <sbi/riscv_barrier.h>
 #include <sbi/riscv_encoding.h>
 #include <sbi/riscv_fp.h>
+#include <sbi/riscv_locks.h>
 #include <sbi/sbi_bitops.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_domain.h>
 #include <sbi/sbi_csr_detect.h>
+#include <sbi/sbi_emulate_csr.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_math.h>
@@ -35,9 +37,33 @@ struct hart_features {
 	unsigned long pmp_gran;
 	unsigned int mhpm_count;
 	unsigned int mhpm_bits;
+	bool detected;
 };
 static unsigned long hart_features_offset;
 
+/* Detected features shared by HARTs of the same implementation */
+#define HART_FEATURE_CLASS_MAX		4
+
+struct hart_feature_class {
+	unsigned long mvendorid;
+	unsigned long marchid;
+	unsigned long mimpid;
+	unsigned long misa;
+	struct hart_features features;
+};
+
+static spinlock_t hart_feature_class_lock = SPIN_LOCK_INITIALIZER;
+static unsigned long hart_feature_class_count;
+static struct hart_feature_class hart_feature_classes[HART_FEATURE_CLASS_MAX];
+
+/* PMP entries per pmpcfg CSR and CSR number step between pmpcfg CSRs */
+#define HART_PMP_CFG_ENTRIES		(__riscv_xlen / 8)
+#define HART_PMP_CFG_STRIDE		(__riscv_xlen / 32)
+
+/* Most PMP entries and MHPM counters (mhpmcounter3 - 31) a HART can have */
+#define HART_PMP_ENTRIES_MAX		64
+#define HART_MHPM_COUNTERS_MAX		29
+
 static void mstatus_init(struct sbi_scratch *scratch)
 {
 	unsigned long mstatus_val = 0;
@@ -64,6 +90,16 @@ static void mstatus_init(struct sbi_scratch *scratch)
 	 */
 	if (sbi_hart_has_feature(scratch, SBI_HART_HAS_MCOUNTEREN))
 		csr_write(CSR_MCOUNTEREN, -1);
+	sbi_emulate_csr_update(scratch);
+
+	/* Let S-mode program its timer directly through stimecmp */
+	if (sbi_hart_has_feature(scratch, SBI_HART_HAS_SSTC)) {
+#if __riscv_xlen == 32
+		csr_set(CSR_MENVCFGH, ENVCFG_STCE >> 32);
+#else
+		csr_set(CSR_MENVCFG, ENVCFG_STCE);
+#endif
+	}
 
 	/* All programmable counters will start running at runtime after S-mode request */
 	if (sbi_hart_has_feature(scratch, SBI_HART_HAS_MCOUNTINHIBIT))
@@ -257,55 +293,218 @@ int pmp_set_tor(unsigned int n, unsigned long prot, unsigned long addr_start, un
 }
 
 
-int sbi_hart_pmp_configure(struct sbi_scratch *scratch)
+static void hart_pmp_image_set(struct sbi_domain_pmp_image *img,
+			       unsigned int n, unsigned long prot,
+			       unsigned long pmpaddr)
 {
-	struct sbi_domain_memregion *reg;
-	struct sbi_domain *dom = sbi_domain_thishart_ptr();
-	unsigned int pmp_idx = 0, pmp_flags, pmp_bits, pmp_gran_log2;
-	unsigned int pmp_count = sbi_hart_pmp_count(scratch);
-	unsigned long pmp_addr = 0, pmp_addr_max = 0;
+	img->addr[n] = pmpaddr;
+	img->cfg[n / HART_PMP_CFG_ENTRIES] |=
+		(prot & 0xffUL) << ((n % HART_PMP_CFG_ENTRIES) << 3);
+}
 
-	if (!pmp_count)
-		return 0;
+/* Same pmpaddr encoding as pmp_set() */
+static unsigned long hart_pmp_napot_addr(unsigned long addr,
+					 unsigned long log2len)
+{
+	unsigned long addrmask;
+
+	if (log2len == PMP_SHIFT)
+		return addr >> PMP_SHIFT;
+	if (log2len == __riscv_xlen)
+		return -1UL;
+
+	addrmask = (1UL << (log2len - PMP_SHIFT)) - 1;
+	return ((addr >> PMP_SHIFT) & ~addrmask) | (addrmask >> 1);
+}
+
+/* Same pmpaddr encoding as pmp_set_tor() */
+static unsigned long hart_pmp_tor_addr(unsigned long addr)
+{
+	return (addr >> 2) & ~(NAPOT_SIZE >> 3);
+}
+
+/**
+ * Map a memory region of a domain to PMP entry flags (without the address
+ * matching mode). Returns SBI_EINVAL, after telling the user, when the PMP
+ * of the HART can't describe a naturally aligned region.
+ */
+static int hart_pmp_region_flags(struct sbi_scratch *scratch,
+				 const struct sbi_domain *dom,
+				 const struct sbi_domain_memregion *reg)
+{
+	unsigned int pmp_flags = 0, pmp_bits, pmp_gran_log2;
+	unsigned long pmp_addr_max;
+
+	if (reg->flags & SBI_DOMAIN_MEMREGION_READABLE)
+		pmp_flags |= PMP_R;
+	if (reg->flags & SBI_DOMAIN_MEMREGION_WRITEABLE)
+		pmp_flags |= PMP_W;
+	if (reg->flags & SBI_DOMAIN_MEMREGION_EXECUTABLE)
+		pmp_flags |= PMP_X;
+	if (reg->flags & SBI_DOMAIN_MEMREGION_MMODE)
+		pmp_flags |= PMP_L;
+
+	if (reg->tor)
+		return pmp_flags;
 
 	pmp_gran_log2 = log2roundup(sbi_hart_pmp_granularity(scratch));
 	pmp_bits = sbi_hart_pmp_addrbits(scratch) - 1;
 	pmp_addr_max = (1UL << pmp_bits) | ((1UL << pmp_bits) - 1);
+	if (pmp_gran_log2 <= reg->order &&
+	    (reg->base >> PMP_SHIFT) < pmp_addr_max)
+		return pmp_flags;
+
+	sbi_printf("Can not configure pmp for domain %s", dom->name);
+	sbi_printf(" because memory region address %lx or size %lx is not in range\n",
+		   reg->base, reg->order);
+	return SBI_EINVAL;
+}
+
+/**
+ * Build the PMP CSR values of a domain once so that applying the domain
+ * on a HART is a plain sequence of CSR writes. The image covers every
+ * PMP entry of the calling HART and is only used on HARTs with the same
+ * PMP geometry, other HARTs program the PMP from the regions.
+ */
+int sbi_hart_pmp_image_build(struct sbi_scratch *scratch,
+			     struct sbi_domain *dom)
+{
+	int pmp_flags;
+	struct sbi_domain_memregion *reg;
+	struct sbi_domain_pmp_image *img = &dom->pmp_image;
+	unsigned int pmp_idx = 0;
+	unsigned int pmp_count = sbi_hart_pmp_count(scratch);
+
+	sbi_memset(img, 0, sizeof(*img));
+	if (!pmp_count || SBI_DOMAIN_PMP_MAX < pmp_count)
+		return 0;
 
 	sbi_domain_for_each_memregion(dom, reg) {
 		if (pmp_count <= pmp_idx)
 			break;
 
-		pmp_flags = 0;
-		if (reg->flags & SBI_DOMAIN_MEMREGION_READABLE)
-			pmp_flags |= PMP_R;
-		if (reg->flags & SBI_DOMAIN_MEMREGION_WRITEABLE)
-			pmp_flags |= PMP_W;
-		if (reg->flags & SBI_DOMAIN_MEMREGION_EXECUTABLE)
-			pmp_flags |= PMP_X;
-		if (reg->flags & SBI_DOMAIN_MEMREGION_MMODE)
-			pmp_flags |= PMP_L;
+		pmp_flags = hart_pmp_region_flags(scratch, dom, reg);
+		if (pmp_flags < 0)
+			continue;
 
 		if (!reg->tor) {
-			pmp_addr =  reg->base >> PMP_SHIFT;
-			if (pmp_gran_log2 <= reg->order && pmp_addr < pmp_addr_max)
-				pmp_set(pmp_idx++, pmp_flags, reg->base, reg->order);
-			else {
-				sbi_printf("Can not configure pmp for domain %s", dom->name);
-				sbi_printf(" because memory region address %lx or size %lx is not in range\n",
-					reg->base, reg->order);
+			if (PMP_SHIFT <= reg->order &&
+			    reg->order <= __riscv_xlen) {
+				pmp_flags |= (reg->order == PMP_SHIFT) ?
+					     PMP_A_NA4 : PMP_A_NAPOT;
+				hart_pmp_image_set(img, pmp_idx, pmp_flags,
+					hart_pmp_napot_addr(reg->base,
+							    reg->order));
 			}
+			pmp_idx++;
 		} else {
-			pmp_addr =  reg->base;
-			pmp_set_tor(pmp_idx, pmp_flags, reg->base, reg->base+reg->tor);
-			pmp_idx+=2;
+			if (pmp_count < pmp_idx + 2)
+				goto unusable;
+			hart_pmp_image_set(img, pmp_idx, pmp_flags,
+					   hart_pmp_tor_addr(reg->base));
+			hart_pmp_image_set(img, pmp_idx + 1,
+					   pmp_flags | PMP_A_TOR,
+					   hart_pmp_tor_addr(reg->base +
+							     reg->tor));
+			pmp_idx += 2;
 		}
-		
 	}
 
+	img->count = pmp_count;
+	img->gran_log2 = log2roundup(sbi_hart_pmp_granularity(scratch));
+	img->addr_bits = sbi_hart_pmp_addrbits(scratch);
+	return 0;
+
+unusable:
+	sbi_memset(img, 0, sizeof(*img));
 	return 0;
 }
 
+static bool hart_pmp_image_usable(struct sbi_scratch *scratch,
+				  const struct sbi_domain_pmp_image *img)
+{
+	return img->count && img->count == sbi_hart_pmp_count(scratch) &&
+	       img->gran_log2 ==
+			log2roundup(sbi_hart_pmp_granularity(scratch)) &&
+	       img->addr_bits == sbi_hart_pmp_addrbits(scratch);
+}
+
+static int hart_pmp_regions_configure(struct sbi_scratch *scratch,
+				      const struct sbi_domain *dom)
+{
+	int pmp_flags;
+	struct sbi_domain_memregion *reg;
+	unsigned int pmp_idx = 0;
+	unsigned int pmp_count = sbi_hart_pmp_count(scratch);
+
+	sbi_domain_for_each_memregion(dom, reg) {
+		if (pmp_count <= pmp_idx)
+			break;
+
+		pmp_flags = hart_pmp_region_flags(scratch, dom, reg);
+		if (pmp_flags < 0)
+			continue;
+
+		if (!reg->tor) {
+			pmp_set(pmp_idx++, pmp_flags, reg->base, reg->order);
+		} else {
+			pmp_set_tor(pmp_idx, pmp_flags, reg->base,
+				    reg->base + reg->tor);
+			pmp_idx += 2;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Program the PMP of the current HART for the given domain.
+ *
+ * The precomputed PMP image of the domain is written as one burst of
+ * pmpaddr and pmpcfg CSR writes which also clears the entries unused by
+ * the domain, so this is usable for switching a HART between domains.
+ * Locked entries can't be rewritten until the HART is reset, so switching
+ * away from an image with locked entries fails with SBI_EDENIED.
+ * Domains without a usable image fall back to walking their regions.
+ */
+int sbi_hart_pmp_apply(struct sbi_scratch *scratch,
+		       const struct sbi_domain *dom)
+{
+	unsigned int i;
+	unsigned long cfg, lmask = 0;
+	const struct sbi_domain_pmp_image *img = &dom->pmp_image;
+
+	if (!sbi_hart_pmp_count(scratch))
+		return 0;
+
+	if (!hart_pmp_image_usable(scratch, img))
+		return hart_pmp_regions_configure(scratch, dom);
+
+	for (i = 0; i < HART_PMP_CFG_ENTRIES; i++)
+		lmask |= PMP_L << (i << 3);
+	for (i = 0; i < img->count; i += HART_PMP_CFG_ENTRIES) {
+		cfg = csr_read_num(CSR_PMPCFG0 +
+				   (i / HART_PMP_CFG_ENTRIES) *
+				   HART_PMP_CFG_STRIDE);
+		if ((cfg & lmask) && cfg != img->cfg[i / HART_PMP_CFG_ENTRIES])
+			return SBI_EDENIED;
+	}
+
+	for (i = 0; i < img->count; i++)
+		csr_write_num(CSR_PMPADDR0 + i, img->addr[i]);
+	for (i = 0; i < img->count; i += HART_PMP_CFG_ENTRIES)
+		csr_write_num(CSR_PMPCFG0 +
+			      (i / HART_PMP_CFG_ENTRIES) * HART_PMP_CFG_STRIDE,
+			      img->cfg[i / HART_PMP_CFG_ENTRIES]);
+
+	return 0;
+}
+
+int sbi_hart_pmp_configure(struct sbi_scratch *scratch)
+{
+	return sbi_hart_pmp_apply(scratch, sbi_domain_thishart_ptr());
+}
+
 #ifndef BR2_CHIPLET_2
 static void init_bus_blocker(void)
 {
@@ -415,6 +614,12 @@ static inline char *sbi_hart_feature_id2string(unsigned long feature)
 	case SBI_HART_HAS_TIME:
 		fstr = "time";
 		break;
+	case SBI_HART_HAS_SSTC:
+		fstr = "sstc";
+		break;
+	case SBI_HART_HAS_SVINVAL:
+		fstr = "svinval";
+		break;
 	default:
 		break;
 	}
@@ -515,6 +720,25 @@ static int hart_pmu_get_allowed_bits(void)
 	return num_bits;
 }
 
+/* Execute SFENCE.W.INVAL which traps as illegal without Svinval */
+static void hart_sfence_w_inval_allowed(struct sbi_trap_info *trap)
+{
+	register ulong tinfo asm("a3") = (ulong)trap;
+	register ulong ttmp asm("a4");
+	register ulong mtvec = sbi_hart_expected_trap_addr();
+
+	trap->cause = 0;
+	asm volatile(
+		"add %[ttmp], %[tinfo], zero\n"
+		"csrrw %[mtvec], " STR(CSR_MTVEC) ", %[mtvec]\n"
+		".word 0x18000073\n"
+		"csrw " STR(CSR_MTVEC) ", %[mtvec]"
+	    : [mtvec] "+&r"(mtvec), [tinfo] "+&r"(tinfo),
+	      [ttmp] "+&r"(ttmp)
+	    :
+	    : "memory");
+}
+
 static void hart_detect_features(struct sbi_scratch *scratch)
 {
 	struct sbi_trap_info trap = {0};
@@ -638,6 +862,176 @@ __mhpm_skip:
 	csr_read_allowed(CSR_TIME, (unsigned long)&trap);
 	if (!trap.cause)
 		hfeatures->features |= SBI_HART_HAS_TIME;
+
+	/* Detect if hart supports Sstc (needs menvcfg to enable it) */
+	csr_read_allowed(CSR_MENVCFG, (unsigned long)&trap);
+	if (!trap.cause) {
+		csr_read_allowed(CSR_STIMECMP, (unsigned long)&trap);
+		if (!trap.cause)
+			hfeatures->features |= SBI_HART_HAS_SSTC;
+	}
+
+	/* Detect if hart supports Svinval */
+	hart_sfence_w_inval_allowed(&trap);
+	if (!trap.cause)
+		hfeatures->features |= SBI_HART_HAS_SVINVAL;
+}
+
+/*
+ * Check that a PMPADDRx or MHPMCOUNTERx CSR keeps the written value,
+ * the same test which hart_detect_features() uses to count them.
+ */
+static bool hart_csr_probe(int csr_num, unsigned long wrval)
+{
+	unsigned long val;
+	struct sbi_trap_info trap = {0};
+
+	switch (csr_num) {
+#define __probe_csr(__csr)						\
+	case __csr:							\
+		val = csr_read_allowed(__csr, (ulong)&trap);		\
+		if (trap.cause)						\
+			return false;					\
+		csr_write_allowed(__csr, (ulong)&trap, wrval);		\
+		if (trap.cause)						\
+			return false;					\
+		return csr_swap(__csr, val) == wrval;
+#define __probe_csr_2(__csr)						\
+	__probe_csr(__csr + 0)						\
+	__probe_csr(__csr + 1)
+#define __probe_csr_4(__csr)						\
+	__probe_csr_2(__csr + 0)					\
+	__probe_csr_2(__csr + 2)
+#define __probe_csr_8(__csr)						\
+	__probe_csr_4(__csr + 0)					\
+	__probe_csr_4(__csr + 4)
+#define __probe_csr_16(__csr)						\
+	__probe_csr_8(__csr + 0)					\
+	__probe_csr_8(__csr + 8)
+#define __probe_csr_32(__csr)						\
+	__probe_csr_16(__csr + 0)					\
+	__probe_csr_16(__csr + 16)
+#define __probe_csr_64(__csr)						\
+	__probe_csr_32(__csr + 0)					\
+	__probe_csr_32(__csr + 32)
+
+	__probe_csr_64(CSR_PMPADDR0)
+	__probe_csr_16(CSR_MHPMCOUNTER3)
+	__probe_csr_8(CSR_MHPMCOUNTER19)
+	__probe_csr_4(CSR_MHPMCOUNTER27)
+	__probe_csr(CSR_MHPMCOUNTER31)
+
+#undef __probe_csr_64
+#undef __probe_csr_32
+#undef __probe_csr_16
+#undef __probe_csr_8
+#undef __probe_csr_4
+#undef __probe_csr_2
+#undef __probe_csr
+	default:
+		return false;
+	}
+}
+
+/*
+ * Cheap check that features cached for a HART class also hold for the
+ * current HART: the PMP address mask, the last PMP entry and MHPM
+ * counter present and the first ones absent. Vendors may ship parts
+ * with the same ID CSRs but different PMP or counter configurations.
+ */
+static bool hart_features_probe(const struct hart_features *hfeatures)
+{
+	unsigned long val = hart_pmp_get_allowed_addr();
+	unsigned long pmp_count = hfeatures->pmp_count;
+	unsigned long mhpm_count = hfeatures->mhpm_count;
+
+	if (!val)
+		return !pmp_count;
+	if (hfeatures->pmp_gran != 1 << (__ffs(val) + 2) ||
+	    hfeatures->pmp_addr_bits != __fls(val) + 1)
+		return false;
+	if (pmp_count && !hart_csr_probe(CSR_PMPADDR0 + pmp_count - 1, val))
+		return false;
+	if (pmp_count < HART_PMP_ENTRIES_MAX &&
+	    hart_csr_probe(CSR_PMPADDR0 + pmp_count, val))
+		return false;
+
+	if (mhpm_count &&
+	    !hart_csr_probe(CSR_MHPMCOUNTER3 + mhpm_count - 1, 1UL))
+		return false;
+	if (mhpm_count < HART_MHPM_COUNTERS_MAX &&
+	    hart_csr_probe(CSR_MHPMCOUNTER3 + mhpm_count, 1UL))
+		return false;
+
+	return true;
+}
+
+static bool hart_feature_class_match(const struct hart_feature_class *a,
+				     const struct hart_feature_class *b)
+{
+	return a->mvendorid == b->mvendorid && a->marchid == b->marchid &&
+	       a->mimpid == b->mimpid && a->misa == b->misa;
+}
+
+static void hart_init_features(struct sbi_scratch *scratch,
+			       struct hart_features *hfeatures)
+{
+	unsigned long i;
+	bool found = false;
+	struct hart_features cached;
+	struct hart_feature_class key;
+	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
+
+	/* HARTs of a heterogeneous platform always probe themselves */
+	if (sbi_platform_has_heterogeneous_harts(plat)) {
+		hart_detect_features(scratch);
+		goto done;
+	}
+
+	key.mvendorid = csr_read(CSR_MVENDORID);
+	key.marchid = csr_read(CSR_MARCHID);
+	key.mimpid = csr_read(CSR_MIMPID);
+	key.misa = csr_read(CSR_MISA);
+
+	spin_lock(&hart_feature_class_lock);
+	for (i = 0; i < hart_feature_class_count; i++) {
+		if (hart_feature_class_match(&hart_feature_classes[i], &key)) {
+			cached = hart_feature_classes[i].features;
+			found = true;
+			break;
+		}
+	}
+	spin_unlock(&hart_feature_class_lock);
+	if (found) {
+		if (hart_features_probe(&cached)) {
+			*hfeatures = cached;
+			goto done;
+		}
+		/* Same IDs but different features, keep the class as is */
+		hart_detect_features(scratch);
+		goto done;
+	}
+
+	/*
+	 * First HART of its class so probe the features. HARTs of the
+	 * same class racing with us may probe too which is harmless.
+	 */
+	hart_detect_features(scratch);
+
+	spin_lock(&hart_feature_class_lock);
+	for (i = 0; i < hart_feature_class_count; i++) {
+		if (hart_feature_class_match(&hart_feature_classes[i], &key))
+			break;
+	}
+	if (i == hart_feature_class_count &&
+	    hart_feature_class_count < HART_FEATURE_CLASS_MAX) {
+		key.features = *hfeatures;
+		hart_feature_classes[hart_feature_class_count++] = key;
+	}
+	spin_unlock(&hart_feature_class_lock);
+
+done:
+	hfeatures->detected = true;
 }
 
 int sbi_hart_reinit(struct sbi_scratch *scratch)
@@ -659,6 +1053,9 @@ int sbi_hart_reinit(struct sbi_scratch *scratch)
 
 int sbi_hart_init(struct sbi_scratch *scratch, bool cold_boot)
 {
+	int rc;
+	struct hart_features *hfeatures;
+
 	if (cold_boot) {
 		if (misa_extension('H'))
 			sbi_hart_expected_trap = &__sbi_expected_trap_hext;
@@ -669,7 +1066,17 @@ int sbi_hart_init(struct sbi_scratch *scratch, bool cold_boot)
 			return SBI_ENOMEM;
 	}
 
-	hart_detect_features(scratch);
+	rc = sbi_emulate_csr_init(scratch, cold_boot);
+	if (rc)
+		return rc;
+
+	/*
+	 * Features of a HART don't change across hotplug so they are
+	 * found only on its first init.
+	 */
+	hfeatures = sbi_scratch_offset_ptr(scratch, hart_features_offset);
+	if (!hfeatures->detected)
+		hart_init_features(scratch, hfeatures);
 
 	return sbi_hart_reinit(scratch);
 }
@@ -29,6 +29,13 @@
 static const struct sbi_hsm_device *hsm_dev = NULL;
 static unsigned long hart_data_offset;
 
+/*
+ * HARTs in STARTED or SUSPENDED state. Updated by each HART on its own
+ * state transitions so that IPI senders don't have to look at the HSM
+ * state of every target HART.
+ */
+static struct sbi_hartmask hsm_interruptible_harts;
+
 /** Per hart specific data to manage state transition **/
 struct sbi_hsm_data {
 	atomic_t state;
@@ -50,6 +57,20 @@ static inline int __sbi_hsm_hart_get_state(u32 hartid)
 	return atomic_read(&hdata->state);
 }
 
+static inline void hsm_set_interruptible(u32 hartid)
+{
+	if (hartid < SBI_HARTMASK_MAX_BITS)
+		atomic_raw_set_bit(hartid,
+				   sbi_hartmask_bits(&hsm_interruptible_harts));
+}
+
+static inline void hsm_clear_interruptible(u32 hartid)
+{
+	if (hartid < SBI_HARTMASK_MAX_BITS)
+		atomic_raw_clear_bit(hartid,
+				     sbi_hartmask_bits(&hsm_interruptible_harts));
+}
+
 int sbi_hsm_hart_get_state(const struct sbi_domain *dom, u32 hartid)
 {
 	if (!sbi_domain_is_assigned_hart(dom, hartid))
@@ -69,26 +90,21 @@ int sbi_hsm_hart_get_state(const struct sbi_domain *dom, u32 hartid)
 int sbi_hsm_hart_interruptible_mask(const struct sbi_domain *dom,
 				    ulong hbase, ulong *out_hmask)
 {
-	int hstate;
-	ulong i, hmask, dmask;
-	ulong hend = sbi_scratch_last_hartid() + 1;
+	ulong bword, boff, imask;
+	volatile ulong *ibits = sbi_hartmask_bits(&hsm_interruptible_harts);
 
 	*out_hmask = 0;
-	if (hend <= hbase)
+	if (sbi_scratch_last_hartid() < hbase)
 		return SBI_EINVAL;
-	if (BITS_PER_LONG < (hend - hbase))
-		hend = hbase + BITS_PER_LONG;
-
-	dmask = sbi_domain_get_assigned_hartmask(dom, hbase);
-	for (i = hbase; i < hend; i++) {
-		hmask = 1UL << (i - hbase);
-		if (dmask & hmask) {
-			hstate = __sbi_hsm_hart_get_state(i);
-			if (hstate == SBI_HSM_STATE_STARTED ||
-			    hstate == SBI_HSM_STATE_SUSPENDED)
-				*out_hmask |= hmask;
-		}
-	}
+
+	bword = BIT_WORD(hbase);
+	boff = BIT_WORD_OFFSET(hbase);
+
+	imask = ibits[bword++] >> boff;
+	if (boff && bword < BIT_WORD(SBI_HARTMASK_MAX_BITS))
+		imask |= ibits[bword] << (BITS_PER_LONG - boff);
+
+	*out_hmask = imask & sbi_domain_get_assigned_hartmask(dom, hbase);
 
 	return 0;
 }
@@ -103,6 +119,8 @@ void sbi_hsm_prepare_next_jump(struct sbi_scratch *scratch, u32 hartid)
 				  SBI_HSM_STATE_STARTED);
 	if (oldstate != SBI_HSM_STATE_START_PENDING)
 		sbi_hart_hang();
+
+	hsm_set_interruptible(hartid);
 }
 
 static void sbi_hsm_hart_wait(struct sbi_scratch *scratch, u32 hartid)
@@ -306,6 +324,7 @@ int sbi_hsm_hart_stop(struct sbi_scratch *scratch, bool exitnow)
 			   __func__, oldstate);
 		return SBI_EFAIL;
 	}
+	hsm_clear_interruptible(current_hartid());
 
 	if (exitnow)
 		sbi_exit(scratch);
@@ -384,6 +403,7 @@ void sbi_hsm_hart_resume_start(struct sbi_scratch *scratch)
 			   __func__, oldstate);
 		sbi_hart_hang();
 	}
+	hsm_clear_interruptible(current_hartid());
 }
 
 void sbi_hsm_hart_resume_finish(struct sbi_scratch *scratch)
@@ -400,6 +420,7 @@ void sbi_hsm_hart_resume_finish(struct sbi_scratch *scratch)
 			   __func__, oldstate);
 		sbi_hart_hang();
 	}
+	hsm_set_interruptible(current_hartid());
 
 	/*
 	 * Restore some of the M-mode CSRs which we are re-configured by
@@ -18,6 +18,7 @@
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_hsm.h>
+#include <sbi/sbi_init.h>
 #include <sbi/sbi_ipi.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_pmu.h>
@@ -37,6 +38,91 @@
 	"        | |\n"                                     \
 	"        |_|\n\n"
 
+static unsigned long boot_trace_offset;
+
+static const char *const boot_phase_names[SBI_BOOT_PHASE_MAX] = {
+	[SBI_BOOT_PHASE_ENTRY]			= "entry",
+	[SBI_BOOT_PHASE_SCRATCH]		= "scratch",
+	[SBI_BOOT_PHASE_DOMAIN_INIT]		= "domain-init",
+	[SBI_BOOT_PHASE_HSM]			= "hsm",
+	[SBI_BOOT_PHASE_EARLY_INIT]		= "early-init",
+	[SBI_BOOT_PHASE_HART]			= "hart",
+	[SBI_BOOT_PHASE_CONSOLE]		= "console",
+	[SBI_BOOT_PHASE_PMU]			= "pmu",
+	[SBI_BOOT_PHASE_IRQCHIP]		= "irqchip",
+	[SBI_BOOT_PHASE_IPI]			= "ipi",
+	[SBI_BOOT_PHASE_TLB]			= "tlb",
+	[SBI_BOOT_PHASE_TIMER]			= "timer",
+	[SBI_BOOT_PHASE_ECALL]			= "ecall",
+	[SBI_BOOT_PHASE_DOMAIN_FINALIZE]	= "domain-finalize",
+	[SBI_BOOT_PHASE_PMP]			= "pmp",
+	[SBI_BOOT_PHASE_FINAL_INIT]		= "final-init",
+	[SBI_BOOT_PHASE_NEXT_ENTRY]		= "next-entry",
+};
+
+static u64 boot_trace_cycles(void)
+{
+#if __riscv_xlen == 32
+	u32 lo, hi, tmp;
+
+	do {
+		hi = csr_read(CSR_MCYCLEH);
+		lo = csr_read(CSR_MCYCLE);
+		tmp = csr_read(CSR_MCYCLEH);
+	} while (hi != tmp);
+
+	return ((u64)hi << 32) | lo;
+#else
+	return csr_read(CSR_MCYCLE);
+#endif
+}
+
+static void boot_trace_set(struct sbi_scratch *scratch,
+			   enum sbi_boot_phase phase, u64 stamp)
+{
+	u64 *trace;
+
+	if (!boot_trace_offset)
+		return;
+
+	trace = sbi_scratch_offset_ptr(scratch, boot_trace_offset);
+	trace[phase] = stamp;
+}
+
+static void boot_trace(struct sbi_scratch *scratch, enum sbi_boot_phase phase)
+{
+	boot_trace_set(scratch, phase, boot_trace_cycles());
+}
+
+/* Start a new trace of the HART which replaces its previous one */
+static void boot_trace_restart(struct sbi_scratch *scratch, u64 entry)
+{
+	if (!boot_trace_offset)
+		return;
+
+	sbi_memset(sbi_scratch_offset_ptr(scratch, boot_trace_offset),
+		   0, sizeof(u64) * SBI_BOOT_PHASE_MAX);
+	boot_trace_set(scratch, SBI_BOOT_PHASE_ENTRY, entry);
+}
+
+static void boot_trace_print(struct sbi_scratch *scratch, u32 hartid)
+{
+	int phase;
+	u64 *trace;
+
+	if (!boot_trace_offset)
+		return;
+
+	trace = sbi_scratch_offset_ptr(scratch, boot_trace_offset);
+	for (phase = SBI_BOOT_PHASE_ENTRY; phase < SBI_BOOT_PHASE_MAX; phase++) {
+		if (!trace[phase])
+			continue;
+		sbi_printf("HART%u boot phase %-16s: %lu cycles\n", hartid,
+			   boot_phase_names[phase],
+			   (ulong)(trace[phase] - trace[SBI_BOOT_PHASE_ENTRY]));
+	}
+}
+
 static void sbi_boot_print_banner(struct sbi_scratch *scratch)
 {
 	if (scratch->options & SBI_SCRATCH_NO_BOOT_PRINTS)
@@ -83,6 +169,9 @@ static void sbi_boot_print_general(struct sbi_scratch *scratch)
 	idev = sbi_ipi_get_device();
 	sbi_printf("Platform IPI Device       : %s\n",
 		   (idev) ? idev->name : "---");
+	idev = sbi_ipi_get_smode_device();
+	sbi_printf("Platform S-IPI Device     : %s\n",
+		   (idev) ? idev->name : "---");
 	tdev = sbi_timer_get_device();
 	sbi_printf("Platform Timer Device     : %s @ %luHz\n",
 		   (tdev) ? tdev->name : "---",
@@ -109,6 +198,12 @@ static void sbi_boot_print_general(struct sbi_scratch *scratch)
 	sbi_printf("Runtime SBI Version       : %d.%d\n",
 		   sbi_ecall_version_major(), sbi_ecall_version_minor());
 	sbi_printf("\n");
+
+	/* Boot phase trace of the coldboot HART */
+	if (scratch->options & SBI_SCRATCH_DEBUG_PRINTS) {
+		boot_trace_print(scratch, current_hartid());
+		sbi_printf("\n");
+	}
 }
 
 static void sbi_boot_print_domains(struct sbi_scratch *scratch)
@@ -157,7 +252,24 @@ static void sbi_boot_print_hart(struct sbi_scratch *scratch, u32 hartid)
 static spinlock_t coldboot_lock = SPIN_LOCK_INITIALIZER;
 static struct sbi_hartmask coldboot_wait_hmask = { 0 };
 
-static unsigned long coldboot_done;
+/* Per-HART scratch space is set up so HART-local init can start */
+#define COLDBOOT_PHASE_HART		1
+/* Coldboot is finished */
+#define COLDBOOT_PHASE_DONE		2
+
+static unsigned long coldboot_phase;
+
+static void set_coldboot_phase(unsigned long phase)
+{
+	__smp_store_release(&coldboot_phase, phase);
+}
+
+static void wait_for_coldboot_phase_hart(void)
+{
+	/* IPIs are not set up this early in coldboot so poll instead */
+	while (__smp_load_acquire(&coldboot_phase) < COLDBOOT_PHASE_HART)
+		cpu_relax();
+}
 
 static void wait_for_coldboot(struct sbi_scratch *scratch, u32 hartid)
 {
@@ -179,7 +291,7 @@ static void wait_for_coldboot(struct sbi_scratch *scratch, u32 hartid)
 	spin_unlock(&coldboot_lock);
 
 	/* Wait for coldboot to finish using WFI */
-	while (!__smp_load_acquire(&coldboot_done)) {
+	while (__smp_load_acquire(&coldboot_phase) < COLDBOOT_PHASE_DONE) {
 		do {
 			wfi();
 			cmip = csr_read(CSR_MIP);
@@ -211,7 +323,7 @@ static void wait_for_coldboot(struct sbi_scratch *scratch, u32 hartid)
 static void wake_coldboot_harts(struct sbi_scratch *scratch, u32 hartid)
 {
 	/* Mark coldboot done */
-	__smp_store_release(&coldboot_done, 1);
+	set_coldboot_phase(COLDBOOT_PHASE_DONE);
 
 	/* Acquire coldboot lock */
 	spin_lock(&coldboot_lock);
@@ -228,10 +340,10 @@ static void wake_coldboot_harts(struct sbi_scratch *scratch, u32 hartid)
 }
 
 static unsigned long init_count_offset;
-
 static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 {
 	int rc;
+	u64 entry, scratch_done;
 	unsigned long *init_count;
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
 
@@ -250,16 +362,27 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 	writel(fw_text_start_addr&0xfffffffful, (void *)(0x71828000UL + 0x338));
 	writel(0xfffffffful, (void *)(0x71828000UL + 0x44c));  //release die1 u84
 #endif
+	entry = boot_trace_cycles();
+
 	/* Note: This has to be first thing in coldboot init sequence */
 	rc = sbi_scratch_init(scratch);
 	if (rc)
 		sbi_hart_hang();
+	scratch_done = boot_trace_cycles();
 
 	/* Note: This has to be second thing in coldboot init sequence */
 	rc = sbi_domain_init(scratch, hartid);
 	if (rc)
 		sbi_hart_hang();
 
+	boot_trace_offset = sbi_scratch_alloc_offset(
+				sizeof(u64) * SBI_BOOT_PHASE_MAX);
+	if (!boot_trace_offset)
+		sbi_hart_hang();
+	boot_trace_set(scratch, SBI_BOOT_PHASE_ENTRY, entry);
+	boot_trace_set(scratch, SBI_BOOT_PHASE_SCRATCH, scratch_done);
+	boot_trace(scratch, SBI_BOOT_PHASE_DOMAIN_INIT);
+
 	init_count_offset = sbi_scratch_alloc_offset(__SIZEOF_POINTER__);
 	if (!init_count_offset)
 		sbi_hart_hang();
@@ -267,22 +390,30 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 	rc = sbi_hsm_init(scratch, hartid, TRUE);
 	if (rc)
 		sbi_hart_hang();
+	boot_trace(scratch, SBI_BOOT_PHASE_HSM);
 
 	rc = sbi_platform_early_init(plat, TRUE);
 	if (rc)
 		sbi_hart_hang();
+	boot_trace(scratch, SBI_BOOT_PHASE_EARLY_INIT);
 
 	rc = sbi_hart_init(scratch, TRUE);
 	if (rc)
 		sbi_hart_hang();
+	boot_trace(scratch, SBI_BOOT_PHASE_HART);
+
+	/* Let other HARTs do their HART-local init in parallel */
+	set_coldboot_phase(COLDBOOT_PHASE_HART);
 
 	rc = sbi_console_init(scratch);
 	if (rc)
 		sbi_hart_hang();
+	boot_trace(scratch, SBI_BOOT_PHASE_CONSOLE);
 
 	rc = sbi_pmu_init(scratch, TRUE);
 	if (rc)
 		sbi_hart_hang();
+	boot_trace(scratch, SBI_BOOT_PHASE_PMU);
 
 	sbi_boot_print_banner(scratch);
 
@@ -292,30 +423,35 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 			   __func__, rc);
 		sbi_hart_hang();
 	}
+	boot_trace(scratch, SBI_BOOT_PHASE_IRQCHIP);
 
 	rc = sbi_ipi_init(scratch, TRUE);
 	if (rc) {
 		sbi_printf("%s: ipi init failed (error %d)\n", __func__, rc);
 		sbi_hart_hang();
 	}
+	boot_trace(scratch, SBI_BOOT_PHASE_IPI);
 
 	rc = sbi_tlb_init(scratch, TRUE);
 	if (rc) {
 		sbi_printf("%s: tlb init failed (error %d)\n", __func__, rc);
 		sbi_hart_hang();
 	}
+	boot_trace(scratch, SBI_BOOT_PHASE_TLB);
 
 	rc = sbi_timer_init(scratch, TRUE);
 	if (rc) {
 		sbi_printf("%s: timer init failed (error %d)\n", __func__, rc);
 		sbi_hart_hang();
 	}
+	boot_trace(scratch, SBI_BOOT_PHASE_TIMER);
 
 	rc = sbi_ecall_init();
 	if (rc) {
 		sbi_printf("%s: ecall init failed (error %d)\n", __func__, rc);
 		sbi_hart_hang();
 	}
+	boot_trace(scratch, SBI_BOOT_PHASE_ECALL);
 
 	/*
 	 * Note: Finalize domains after HSM initialization so that we
@@ -329,6 +465,7 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 			   __func__, rc);
 		sbi_hart_hang();
 	}
+	boot_trace(scratch, SBI_BOOT_PHASE_DOMAIN_FINALIZE);
 
 	rc = sbi_hart_pmp_configure(scratch);
 	if (rc) {
@@ -338,6 +475,7 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 	}
 
 	sbi_hart_blocker_fscr_configure(scratch);
+	boot_trace(scratch, SBI_BOOT_PHASE_PMP);
 
 	/*
 	 * Note: Platform final initialization should be last so that
@@ -349,6 +487,7 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 			   __func__, rc);
 		sbi_hart_hang();
 	}
+	boot_trace(scratch, SBI_BOOT_PHASE_FINAL_INIT);
 
 	sbi_boot_print_general(scratch);
 
@@ -362,89 +501,134 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 	(*init_count)++;
 
 	sbi_hsm_prepare_next_jump(scratch, hartid);
+	boot_trace(scratch, SBI_BOOT_PHASE_NEXT_ENTRY);
 	sbi_hart_switch_mode(hartid, scratch->next_arg1, scratch->next_addr,
 			     scratch->next_mode, FALSE);
 }
 
-static void init_warm_startup(struct sbi_scratch *scratch, u32 hartid)
+static void init_warm_hart_local(struct sbi_scratch *scratch)
 {
 	int rc;
-	unsigned long *init_count;
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
 
-	if (!init_count_offset)
+	rc = sbi_platform_early_init(plat, FALSE);
+	if (rc)
 		sbi_hart_hang();
+	boot_trace(scratch, SBI_BOOT_PHASE_EARLY_INIT);
 
-	rc = sbi_hsm_init(scratch, hartid, FALSE);
+	rc = sbi_hart_init(scratch, FALSE);
 	if (rc)
 		sbi_hart_hang();
+	boot_trace(scratch, SBI_BOOT_PHASE_HART);
+}
 
-	rc = sbi_platform_early_init(plat, FALSE);
-	if (rc)
+static void init_warm_startup(struct sbi_scratch *scratch, u32 hartid,
+			      bool hart_ready)
+{
+	int rc;
+	unsigned long *init_count;
+	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
+
+	if (!init_count_offset)
 		sbi_hart_hang();
 
-	rc = sbi_hart_init(scratch, FALSE);
+	rc = sbi_hsm_init(scratch, hartid, FALSE);
 	if (rc)
 		sbi_hart_hang();
+	boot_trace(scratch, SBI_BOOT_PHASE_HSM);
+
+	if (!hart_ready)
+		init_warm_hart_local(scratch);
 
 	rc = sbi_pmu_init(scratch, FALSE);
 	if (rc)
 		sbi_hart_hang();
+	boot_trace(scratch, SBI_BOOT_PHASE_PMU);
 
 	rc = sbi_platform_irqchip_init(plat, FALSE);
 	if (rc)
 		sbi_hart_hang();
+	boot_trace(scratch, SBI_BOOT_PHASE_IRQCHIP);
 
 	rc = sbi_ipi_init(scratch, FALSE);
 	if (rc)
 		sbi_hart_hang();
+	boot_trace(scratch, SBI_BOOT_PHASE_IPI);
 
 	rc = sbi_tlb_init(scratch, FALSE);
 	if (rc)
 		sbi_hart_hang();
+	boot_trace(scratch, SBI_BOOT_PHASE_TLB);
 
 	rc = sbi_timer_init(scratch, FALSE);
 	if (rc)
 		sbi_hart_hang();
+	boot_trace(scratch, SBI_BOOT_PHASE_TIMER);
 
 	rc = sbi_hart_pmp_configure(scratch);
 	if (rc)
 		sbi_hart_hang();
 
 	sbi_hart_blocker_fscr_configure(scratch);
+	boot_trace(scratch, SBI_BOOT_PHASE_PMP);
 
 	rc = sbi_platform_final_init(plat, FALSE);
 	if (rc)
 		sbi_hart_hang();
+	boot_trace(scratch, SBI_BOOT_PHASE_FINAL_INIT);
 
 	init_count = sbi_scratch_offset_ptr(scratch, init_count_offset);
 	(*init_count)++;
 
+	if (scratch->options & SBI_SCRATCH_DEBUG_PRINTS)
+		boot_trace_print(scratch, hartid);
+
 	sbi_hsm_prepare_next_jump(scratch, hartid);
 }
 
-static void init_warm_resume(struct sbi_scratch *scratch)
+static void init_warm_resume(struct sbi_scratch *scratch, u64 entry)
 {
 	int rc;
 
+	/* A non-retentive resume is traced like a warm start */
+	boot_trace_restart(scratch, entry);
+
 	sbi_hsm_hart_resume_start(scratch);
+	boot_trace(scratch, SBI_BOOT_PHASE_HSM);
 
 	rc = sbi_hart_reinit(scratch);
 	if (rc)
 		sbi_hart_hang();
+	boot_trace(scratch, SBI_BOOT_PHASE_HART);
 
 	rc = sbi_hart_pmp_configure(scratch);
 	if (rc)
 		sbi_hart_hang();
 
 	sbi_hart_blocker_fscr_configure(scratch);
+	boot_trace(scratch, SBI_BOOT_PHASE_PMP);
 
 	sbi_hsm_hart_resume_finish(scratch);
+	boot_trace(scratch, SBI_BOOT_PHASE_NEXT_ENTRY);
 }
 
 static void __noreturn init_warmboot(struct sbi_scratch *scratch, u32 hartid)
 {
 	int hstate;
+	bool hart_ready = FALSE;
+	u64 entry = boot_trace_cycles();
+
+	/*
+	 * During the first boot, the HART-local init which doesn't depend
+	 * on coldboot results (feature detection, FP, trap delegation)
+	 * overlaps with the rest of coldboot instead of following it.
+	 */
+	if (__smp_load_acquire(&coldboot_phase) < COLDBOOT_PHASE_DONE) {
+		wait_for_coldboot_phase_hart();
+		boot_trace_set(scratch, SBI_BOOT_PHASE_ENTRY, entry);
+		init_warm_hart_local(scratch);
+		hart_ready = TRUE;
+	}
 
 	wait_for_coldboot(scratch, hartid);
 
@@ -452,10 +636,15 @@ static void __noreturn init_warmboot(struct sbi_scratch *scratch, u32 hartid)
 	if (hstate < 0)
 		sbi_hart_hang();
 
-	if (hstate == SBI_HSM_STATE_SUSPENDED)
-		init_warm_resume(scratch);
-	else
-		init_warm_startup(scratch, hartid);
+	if (hstate == SBI_HSM_STATE_SUSPENDED) {
+		init_warm_resume(scratch, entry);
+	} else {
+		/* Later warm starts of a HART replace its previous trace */
+		if (!hart_ready)
+			boot_trace_restart(scratch, entry);
+		init_warm_startup(scratch, hartid, hart_ready);
+		boot_trace(scratch, SBI_BOOT_PHASE_NEXT_ENTRY);
+	}
 
 	sbi_hart_switch_mode(hartid, scratch->next_arg1,
 			     scratch->next_addr,
@@ -553,6 +742,31 @@ unsigned long sbi_init_count(u32 hartid)
 	return *init_count;
 }
 
+const char *sbi_init_boot_phase_name(enum sbi_boot_phase phase)
+{
+	if (SBI_BOOT_PHASE_MAX <= phase)
+		return NULL;
+
+	return boot_phase_names[phase];
+}
+
+u64 sbi_init_boot_phase_stamp(u32 hartid, enum sbi_boot_phase phase)
+{
+	u64 *trace;
+	struct sbi_scratch *scratch;
+
+	if (!boot_trace_offset || SBI_BOOT_PHASE_MAX <= phase)
+		return 0;
+
+	scratch = sbi_hartid_to_scratch(hartid);
+	if (!scratch)
+		return 0;
+
+	trace = sbi_scratch_offset_ptr(scratch, boot_trace_offset);
+
+	return trace[phase];
+}
+
 /**
  * Exit OpenSBI library for current HART and stop HART
  *
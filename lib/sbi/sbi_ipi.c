@@ -29,8 +29,12 @@ struct sbi_ipi_data {
 
 static unsigned long ipi_data_off;
 static const struct sbi_ipi_device *ipi_dev = NULL;
+static const struct sbi_ipi_device *ipi_smode_dev = NULL;
+static struct sbi_hartmask ipi_smode_harts;
 static const struct sbi_ipi_event_ops *ipi_ops_array[SBI_IPI_EVENT_MAX];
 
+static u32 ipi_smode_event = SBI_IPI_EVENT_MAX;
+
 static int sbi_ipi_send(struct sbi_scratch *scratch, u32 remote_hartid,
 			u32 event, void *data)
 {
@@ -48,6 +52,18 @@ static int sbi_ipi_send(struct sbi_scratch *scratch, u32 remote_hartid,
 	if (!remote_scratch)
 		return SBI_EINVAL;
 
+	/*
+	 * S-mode IPIs are raised directly on the remote hart when there
+	 * is a device for it so the remote hart does not trap to M-mode.
+	 */
+	if (event == ipi_smode_event && ipi_smode_dev &&
+	    ipi_smode_dev->ipi_send &&
+	    sbi_hartmask_test_hart(remote_hartid, &ipi_smode_harts)) {
+		ipi_smode_dev->ipi_send(remote_hartid);
+		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_IPI_SENT);
+		return 0;
+	}
+
 	ipi_data = sbi_scratch_offset_ptr(remote_scratch, ipi_data_off);
 
 	if (ipi_ops->update) {
@@ -57,21 +73,27 @@ static int sbi_ipi_send(struct sbi_scratch *scratch, u32 remote_hartid,
 			return ret;
 	}
 
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_IPI_SENT);
+
 	/*
-	 * Set IPI type on remote hart's scratch area and
-	 * trigger the interrupt
+	 * Set IPI type on remote hart's scratch area and trigger the
+	 * interrupt only if the event was not already pending.
+	 *
+	 * A pending bit means the remote hart has not yet done the
+	 * xchg in sbi_ipi_process(), which comes after clearing its
+	 * interrupt, and whoever set the bit rings the doorbell after
+	 * setting it. Our update is therefore picked up by that xchg
+	 * and another doorbell would only cause a spurious interrupt.
 	 */
-	atomic_raw_set_bit(event, &ipi_data->ipi_type);
+	if (atomic_raw_set_bit(event, &ipi_data->ipi_type)) {
+		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_IPI_DOORBELL_SKIPPED);
+		return 0;
+	}
 	smp_wmb();
 
 	if (ipi_dev && ipi_dev->ipi_send)
 		ipi_dev->ipi_send(remote_hartid);
 
-	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_IPI_SENT);
-
-	if (ipi_ops->sync)
-		ipi_ops->sync(scratch);
-
 	return 0;
 }
 
@@ -79,14 +101,24 @@ static int sbi_ipi_send(struct sbi_scratch *scratch, u32 remote_hartid,
  * As this this function only handlers scalar values of hart mask, it must be
  * set to all online harts if the intention is to send IPIs to all the harts.
  * If hmask is zero, no IPIs will be sent.
+ *
+ * The IPIs are triggered for all target HARTs first and the sync callback
+ * of the event is called only once at the end, so the remote HARTs handle
+ * the event in parallel.
  */
 int sbi_ipi_send_many(ulong hmask, ulong hbase, u32 event, void *data)
 {
 	int rc;
 	ulong i, m;
+	const struct sbi_ipi_event_ops *ipi_ops;
 	struct sbi_domain *dom = sbi_domain_thishart_ptr();
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
 
+	if ((SBI_IPI_EVENT_MAX <= event) ||
+	    !ipi_ops_array[event])
+		return SBI_EINVAL;
+	ipi_ops = ipi_ops_array[event];
+
 	if (hbase != -1UL) {
 		rc = sbi_hsm_hart_interruptible_mask(dom, hbase, &m);
 		if (rc)
@@ -110,6 +142,9 @@ int sbi_ipi_send_many(ulong hmask, ulong hbase, u32 event, void *data)
 		}
 	}
 
+	if (ipi_ops->sync)
+		ipi_ops->sync(scratch);
+
 	return 0;
 }
 
@@ -149,8 +184,6 @@ static struct sbi_ipi_event_ops ipi_smode_ops = {
 	.process = sbi_ipi_process_smode,
 };
 
-static u32 ipi_smode_event = SBI_IPI_EVENT_MAX;
-
 int sbi_ipi_send_smode(ulong hmask, ulong hbase)
 {
 	return sbi_ipi_send_many(hmask, hbase, ipi_smode_event, NULL);
@@ -180,7 +213,7 @@ int sbi_ipi_send_halt(ulong hmask, ulong hbase)
 
 void sbi_ipi_process(void)
 {
-	unsigned long ipi_type;
+	unsigned long ipi_type, prof;
 	unsigned int ipi_event;
 	const struct sbi_ipi_event_ops *ipi_ops;
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
@@ -198,9 +231,11 @@ void sbi_ipi_process(void)
 		if (!(ipi_type & 1UL))
 			goto skip;
 
+		prof = sbi_pmu_prof_begin();
 		ipi_ops = ipi_ops_array[ipi_event];
 		if (ipi_ops && ipi_ops->process)
 			ipi_ops->process(scratch);
+		sbi_pmu_prof_end(SBI_PMU_FW_IPI_CYCLES, ipi_event, prof);
 
 skip:
 		ipi_type = ipi_type >> 1;
@@ -227,6 +262,21 @@ void sbi_ipi_set_device(const struct sbi_ipi_device *dev)
 	ipi_dev = dev;
 }
 
+const struct sbi_ipi_device *sbi_ipi_get_smode_device(void)
+{
+	return ipi_smode_dev;
+}
+
+void sbi_ipi_set_smode_device(const struct sbi_ipi_device *dev,
+			      const struct sbi_hartmask *harts)
+{
+	if (!dev || !harts || (ipi_smode_dev && ipi_smode_dev != dev))
+		return;
+
+	ipi_smode_dev = dev;
+	sbi_hartmask_or(&ipi_smode_harts, &ipi_smode_harts, harts);
+}
+
 int sbi_ipi_init(struct sbi_scratch *scratch, bool cold_boot)
 {
 	int ret;
@@ -10,6 +10,8 @@
 #include <sbi/riscv_asm.h>
 #include <sbi/sbi_bitops.h>
 #include <sbi/sbi_console.h>
+#include <sbi/sbi_emulate_csr.h>
+#include <sbi/sbi_error.h>
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_pmu.h>
@@ -33,18 +35,37 @@ struct sbi_pmu_hw_event {
 	uint64_t select_mask;
 };
 
-/** Representation of a firmware event */
-struct sbi_pmu_fw_event {
-	/* Event associated with the particular counter */
-	uint32_t event_idx;
+/** Per-HART PMU state kept in the scratch space */
+struct sbi_pmu_hart_state {
+	/* Bitmask of firmware events for which monitoring is started */
+	unsigned long fw_started;
 
-	/* Current value of the counter */
-	unsigned long curr_count;
+	/* Current value of the firmware event counters */
+	unsigned long fw_counters[SBI_PMU_FW_EVENT_MAX];
 
-	/* A flag indicating pmu event monitoring is started */
-	bool bStarted;
+	/* Counter to enabled event mapping */
+	uint32_t active_events[SBI_PMU_HW_CTR_MAX + SBI_PMU_FW_CTR_MAX];
+
+	/* Bitmask of firmware counters running a cycle profiling event */
+	unsigned long prof_started;
+
+	/* Event data filter of the cycle profiling counters */
+	uint64_t prof_filter[SBI_PMU_FW_CTR_MAX];
+
+	/* Current value of the cycle profiling counters */
+	unsigned long prof_counters[SBI_PMU_FW_CTR_MAX];
 };
 
+/*
+ * The per-HART state is updated on every trap, IPI and fence so it is
+ * padded to cache lines to avoid sharing a line with data written by
+ * other HARTs.
+ */
+#define PMU_CACHE_LINE_SIZE		64
+#define PMU_HART_STATE_SIZE		\
+	((sizeof(struct sbi_pmu_hart_state) + PMU_CACHE_LINE_SIZE - 1) & \
+	 ~(PMU_CACHE_LINE_SIZE - 1))
+
 /* Information about PMU counters as per SBI specification */
 union sbi_pmu_ctr_info {
 	unsigned long value;
@@ -63,11 +84,8 @@ union sbi_pmu_ctr_info {
 /* Mapping between event range and possible counters  */
 static struct sbi_pmu_hw_event hw_event_map[SBI_PMU_HW_EVENT_MAX] = {0};
 
-/* counter to enabled event mapping */
-static uint32_t active_events[SBI_HARTMASK_MAX_BITS][SBI_PMU_HW_CTR_MAX + SBI_PMU_FW_CTR_MAX];
-
-/* Contains all the information about firmwares events */
-static struct sbi_pmu_fw_event fw_event_map[SBI_HARTMASK_MAX_BITS][SBI_PMU_FW_EVENT_MAX] = {0};
+/* Offset of the per-HART PMU state in the scratch space */
+static unsigned long pmu_hart_state_off;
 
 /* Maximum number of hardware events available */
 static uint32_t num_hw_events;
@@ -81,6 +99,34 @@ static uint32_t total_ctrs;
 #define get_cidx_type(x) ((x & SBI_PMU_EVENT_IDX_TYPE_MASK) >> 16)
 #define get_cidx_code(x) (x & SBI_PMU_EVENT_IDX_CODE_MASK)
 
+static inline struct sbi_pmu_hart_state *pmu_get_hart_state(
+						struct sbi_scratch *scratch)
+{
+	unsigned long ptr = (unsigned long)scratch + pmu_hart_state_off;
+
+	return (void *)((ptr + PMU_CACHE_LINE_SIZE - 1) &
+			~(PMU_CACHE_LINE_SIZE - 1));
+}
+
+#define pmu_thishart_state_ptr()	\
+	pmu_get_hart_state(sbi_scratch_thishart_ptr())
+
+/*
+ * Standard and implementation specific firmware events share one
+ * dense index space for the per-HART counters and started bitmask.
+ */
+#define pmu_fw_code_valid(code)		\
+	((code) < SBI_PMU_FW_MAX ||	\
+	 ((code) >= SBI_PMU_FW_IMPL_BASE && (code) < SBI_PMU_FW_IMPL_MAX))
+#define pmu_fw_slot(code)		\
+	(((code) < SBI_PMU_FW_MAX) ? (code) :	\
+	 SBI_PMU_FW_MAX + (code) - SBI_PMU_FW_IMPL_BASE)
+
+/* Cycle profiling events keep their value per firmware counter */
+#define pmu_fw_is_prof(code)		\
+	((code) >= SBI_PMU_FW_TRAP_CYCLES && (code) <= SBI_PMU_FW_IPI_CYCLES)
+#define pmu_prof_slot(cidx)		((cidx) - num_hw_ctrs - 1)
+
 /**
  * Perform a sanity check on event & counter mappings with event range overlap check
  * @param evtA Pointer to the existing hw event structure
@@ -111,11 +157,13 @@ static int pmu_ctr_validate(uint32_t cidx, uint32_t *event_idx_code)
 {
 	uint32_t event_idx_val;
 	uint32_t event_idx_type;
-	u32 hartid = current_hartid();
+	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
 
-	event_idx_val = active_events[hartid][cidx];
+	if (cidx >= total_ctrs)
+		return SBI_EINVAL;
 
-	if (cidx >= total_ctrs || (event_idx_val == SBI_PMU_EVENT_IDX_INVALID))
+	event_idx_val = phs->active_events[cidx];
+	if (event_idx_val == SBI_PMU_EVENT_IDX_INVALID)
 		return SBI_EINVAL;
 
 	event_idx_type = get_cidx_type(event_idx_val);
@@ -123,6 +171,9 @@ static int pmu_ctr_validate(uint32_t cidx, uint32_t *event_idx_code)
 		return SBI_EINVAL;
 
 	*event_idx_code = get_cidx_code(event_idx_val);
+	if (event_idx_type == SBI_PMU_EVENT_TYPE_FW &&
+	    !pmu_fw_code_valid(*event_idx_code))
+		return SBI_EINVAL;
 
 	return event_idx_type;
 }
@@ -130,11 +181,12 @@ static int pmu_ctr_validate(uint32_t cidx, uint32_t *event_idx_code)
 static int pmu_ctr_read_fw(uint32_t cidx, unsigned long *cval,
 			       uint32_t fw_evt_code)
 {
-	u32 hartid = current_hartid();
-	struct sbi_pmu_fw_event fevent;
+	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
 
-	fevent = fw_event_map[hartid][fw_evt_code];
-	*cval = fevent.curr_count;
+	if (pmu_fw_is_prof(fw_evt_code))
+		*cval = phs->prof_counters[pmu_prof_slot(cidx)];
+	else
+		*cval = phs->fw_counters[pmu_fw_slot(fw_evt_code)];
 
 	return 0;
 }
@@ -323,13 +375,18 @@ skip_inhibit_update:
 static int pmu_ctr_start_fw(uint32_t cidx, uint32_t fw_evt_code,
 			    uint64_t ival, bool ival_update)
 {
-	u32 hartid = current_hartid();
-	struct sbi_pmu_fw_event *fevent;
+	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
+
+	if (pmu_fw_is_prof(fw_evt_code)) {
+		if (ival_update)
+			phs->prof_counters[pmu_prof_slot(cidx)] = ival;
+		phs->prof_started |= BIT(pmu_prof_slot(cidx));
+		return 0;
+	}
 
-	fevent = &fw_event_map[hartid][fw_evt_code];
 	if (ival_update)
-		fevent->curr_count = ival;
-	fevent->bStarted = TRUE;
+		phs->fw_counters[pmu_fw_slot(fw_evt_code)] = ival;
+	phs->fw_started |= BIT(pmu_fw_slot(fw_evt_code));
 
 	return 0;
 }
@@ -387,9 +444,12 @@ static int pmu_ctr_stop_hw(uint32_t cidx)
 
 static int pmu_ctr_stop_fw(uint32_t cidx, uint32_t fw_evt_code)
 {
-	u32 hartid = current_hartid();
+	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
 
-	fw_event_map[hartid][fw_evt_code].bStarted = FALSE;
+	if (pmu_fw_is_prof(fw_evt_code))
+		phs->prof_started &= ~BIT(pmu_prof_slot(cidx));
+	else
+		phs->fw_started &= ~BIT(pmu_fw_slot(fw_evt_code));
 
 	return 0;
 }
@@ -411,7 +471,7 @@ static int pmu_reset_hw_mhpmevent(int ctr_idx)
 int sbi_pmu_ctr_stop(unsigned long cbase, unsigned long cmask,
 		     unsigned long flag)
 {
-	u32 hartid = current_hartid();
+	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
 	int ret = SBI_EINVAL;
 	int event_idx_type;
 	uint32_t event_code;
@@ -432,7 +492,7 @@ int sbi_pmu_ctr_stop(unsigned long cbase, unsigned long cmask,
 			ret = pmu_ctr_stop_hw(cbase);
 
 		if (flag & SBI_PMU_STOP_FLAG_RESET) {
-			active_events[hartid][cbase] = SBI_PMU_EVENT_IDX_INVALID;
+			phs->active_events[cbase] = SBI_PMU_EVENT_IDX_INVALID;
 			pmu_reset_hw_mhpmevent(cbase);
 		}
 	}
@@ -501,8 +561,8 @@ static int pmu_ctr_find_hw(unsigned long cbase, unsigned long cmask, unsigned lo
 	int i, ret = 0, fixed_ctr, ctr_idx = SBI_ENOTSUPP;
 	struct sbi_pmu_hw_event *temp;
 	unsigned long mctr_inhbt = 0;
-	u32 hartid = current_hartid();
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	struct sbi_pmu_hart_state *phs = pmu_get_hart_state(scratch);
 
 	if (cbase > num_hw_ctrs)
 		return SBI_EINVAL;
@@ -540,7 +600,7 @@ static int pmu_ctr_find_hw(unsigned long cbase, unsigned long cmask, unsigned lo
 			 * Some of the platform may not support mcountinhibit.
 			 * Checking the active_events is enough for them
 			 */
-			if (active_events[hartid][cbase] != SBI_PMU_EVENT_IDX_INVALID)
+			if (phs->active_events[cbase] != SBI_PMU_EVENT_IDX_INVALID)
 				continue;
 			/* If mcountinhibit is supported, the bit must be enabled */
 			if ((sbi_hart_has_feature(scratch, SBI_HART_HAS_MCOUNTINHIBIT)) &&
@@ -575,7 +635,8 @@ static int pmu_ctr_find_hw(unsigned long cbase, unsigned long cmask, unsigned lo
  * Thus, select the first available fw counter after sanity
  * check.
  */
-static int pmu_ctr_find_fw(unsigned long cbase, unsigned long cmask, u32 hartid)
+static int pmu_ctr_find_fw(unsigned long cbase, unsigned long cmask,
+			   struct sbi_pmu_hart_state *phs)
 {
 	int i = 0;
 	int fw_base;
@@ -587,7 +648,7 @@ static int pmu_ctr_find_fw(unsigned long cbase, unsigned long cmask, u32 hartid)
 		fw_base = cbase;
 
 	for (i = fw_base; i < total_ctrs; i++)
-		if ((active_events[hartid][i] == SBI_PMU_EVENT_IDX_INVALID) &&
+		if ((phs->active_events[i] == SBI_PMU_EVENT_IDX_INVALID) &&
 		    ((1UL << i) & ctr_mask))
 			return i;
 
@@ -599,9 +660,8 @@ int sbi_pmu_ctr_cfg_match(unsigned long cidx_base, unsigned long cidx_mask,
 			  uint64_t event_data)
 {
 	int ctr_idx = SBI_ENOTSUPP;
-	u32 hartid = current_hartid();
+	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
 	int event_type = get_cidx_type(event_idx);
-	struct sbi_pmu_fw_event *fevent;
 	uint32_t fw_evt_code;
 	unsigned long tmp = cidx_mask << cidx_base;
 
@@ -609,12 +669,16 @@ int sbi_pmu_ctr_cfg_match(unsigned long cidx_base, unsigned long cidx_mask,
 	if (__fls(tmp) >= total_ctrs || event_type >= SBI_PMU_EVENT_TYPE_MAX)
 		return SBI_EINVAL;
 
+	if (event_type == SBI_PMU_EVENT_TYPE_FW &&
+	    !pmu_fw_code_valid(get_cidx_code(event_idx)))
+		return SBI_EINVAL;
+
 	if (flags & SBI_PMU_CFG_FLAG_SKIP_MATCH) {
 		/* The caller wants to skip the match because it already knows the
 		 * counter idx for the given event. Verify that the counter idx
 		 * is still valid.
 		 */
-		if (active_events[hartid][cidx_base] == SBI_PMU_EVENT_IDX_INVALID)
+		if (phs->active_events[cidx_base] == SBI_PMU_EVENT_IDX_INVALID)
 			return SBI_EINVAL;
 		ctr_idx = cidx_base;
 		goto skip_match;
@@ -622,7 +686,7 @@ int sbi_pmu_ctr_cfg_match(unsigned long cidx_base, unsigned long cidx_mask,
 
 	if (event_type == SBI_PMU_EVENT_TYPE_FW) {
 		/* Any firmware counter can be used track any firmware event */
-		ctr_idx = pmu_ctr_find_fw(cidx_base, cidx_mask, hartid);
+		ctr_idx = pmu_ctr_find_fw(cidx_base, cidx_mask, phs);
 	} else {
 		ctr_idx = pmu_ctr_find_hw(cidx_base, cidx_mask, flags, event_idx,
 					  event_data);
@@ -631,7 +695,7 @@ int sbi_pmu_ctr_cfg_match(unsigned long cidx_base, unsigned long cidx_mask,
 	if (ctr_idx < 0)
 		return SBI_ENOTSUPP;
 
-	active_events[hartid][ctr_idx] = event_idx;
+	phs->active_events[ctr_idx] = event_idx;
 skip_match:
 	if (event_type == SBI_PMU_EVENT_TYPE_HW) {
 		if (flags & SBI_PMU_CFG_FLAG_CLEAR_VALUE)
@@ -640,11 +704,17 @@ skip_match:
 			pmu_ctr_start_hw(ctr_idx, 0, false);
 	} else if (event_type == SBI_PMU_EVENT_TYPE_FW) {
 		fw_evt_code = get_cidx_code(event_idx);
-		fevent = &fw_event_map[hartid][fw_evt_code];
-		if (flags & SBI_PMU_CFG_FLAG_CLEAR_VALUE)
-			fevent->curr_count = 0;
+		if (pmu_fw_is_prof(fw_evt_code)) {
+			if (ctr_idx <= num_hw_ctrs)
+				return SBI_EINVAL;
+			phs->prof_filter[pmu_prof_slot(ctr_idx)] = event_data;
+			if (flags & SBI_PMU_CFG_FLAG_CLEAR_VALUE)
+				phs->prof_counters[pmu_prof_slot(ctr_idx)] = 0;
+		} else if (flags & SBI_PMU_CFG_FLAG_CLEAR_VALUE) {
+			phs->fw_counters[pmu_fw_slot(fw_evt_code)] = 0;
+		}
 		if (flags & SBI_PMU_CFG_FLAG_AUTO_START)
-			fevent->bStarted = TRUE;
+			pmu_ctr_start_fw(ctr_idx, fw_evt_code, 0, false);
 	}
 
 	return ctr_idx;
@@ -652,21 +722,81 @@ skip_match:
 
 inline int sbi_pmu_ctr_incr_fw(enum sbi_pmu_fw_event_code_id fw_id)
 {
-	u32 hartid = current_hartid();
-	struct sbi_pmu_fw_event *fevent;
+	struct sbi_pmu_hart_state *phs;
 
-	if (unlikely(fw_id >= SBI_PMU_FW_MAX))
+	if (unlikely(!pmu_fw_code_valid(fw_id)))
 		return SBI_EINVAL;
 
-	fevent = &fw_event_map[hartid][fw_id];
+	/* Nothing to count before the per-HART state is allocated */
+	if (unlikely(!pmu_hart_state_off))
+		return 0;
+
+	phs = pmu_thishart_state_ptr();
 
 	/* PMU counters will be only enabled during performance debugging */
-	if (unlikely(fevent->bStarted))
-		fevent->curr_count++;
+	if (unlikely(phs->fw_started & BIT(pmu_fw_slot(fw_id))))
+		phs->fw_counters[pmu_fw_slot(fw_id)]++;
 
 	return 0;
 }
 
+unsigned long sbi_pmu_prof_begin(void)
+{
+	struct sbi_pmu_hart_state *phs;
+
+	if (unlikely(!pmu_hart_state_off))
+		return 0;
+
+	phs = pmu_thishart_state_ptr();
+
+	/* Cycle profiling is only enabled during performance debugging */
+	if (likely(!phs->prof_started))
+		return 0;
+
+	return csr_read(CSR_MCYCLE);
+}
+
+static bool pmu_prof_match(uint32_t fw_evt_code, uint64_t filter,
+			   uint64_t data)
+{
+	if (filter == SBI_PMU_FW_PROF_ANY)
+		return TRUE;
+
+	if (fw_evt_code != SBI_PMU_FW_ECALL_CYCLES)
+		return (filter == data) ? TRUE : FALSE;
+
+	/* Extension ID and function ID can be wildcards on their own */
+	if ((u32)(filter >> 32) != ~0U &&
+	    (u32)(filter >> 32) != (u32)(data >> 32))
+		return FALSE;
+	if ((u32)filter != ~0U && (u32)filter != (u32)data)
+		return FALSE;
+
+	return TRUE;
+}
+
+void sbi_pmu_prof_end(enum sbi_pmu_fw_event_code_id fw_id, uint64_t data,
+		      unsigned long start)
+{
+	int i;
+	unsigned long cycles, prof_started;
+	struct sbi_pmu_hart_state *phs;
+
+	if (likely(!start))
+		return;
+
+	cycles = csr_read(CSR_MCYCLE) - start;
+	phs = pmu_thishart_state_ptr();
+	prof_started = phs->prof_started;
+	for_each_set_bit(i, &prof_started, SBI_PMU_FW_CTR_MAX) {
+		if (get_cidx_code(phs->active_events[num_hw_ctrs + 1 + i]) !=
+		    fw_id)
+			continue;
+		if (pmu_prof_match(fw_id, phs->prof_filter[i], data))
+			phs->prof_counters[i] += cycles;
+	}
+}
+
 unsigned long sbi_pmu_num_ctr(void)
 {
 	return (num_hw_ctrs + SBI_PMU_FW_CTR_MAX);
@@ -702,35 +832,40 @@ int sbi_pmu_ctr_get_info(uint32_t cidx, unsigned long *ctr_info)
 	return 0;
 }
 
-static void pmu_reset_event_map(u32 hartid)
+static void pmu_reset_event_map(struct sbi_pmu_hart_state *phs)
 {
 	int j;
 
 	/* Initialize the counter to event mapping table */
 	for (j = 3; j < total_ctrs; j++)
-		active_events[hartid][j] = SBI_PMU_EVENT_IDX_INVALID;
-	for (j = 0; j < SBI_PMU_FW_CTR_MAX; j++)
-		sbi_memset(&fw_event_map[hartid][j], 0,
-			   sizeof(struct sbi_pmu_fw_event));
+		phs->active_events[j] = SBI_PMU_EVENT_IDX_INVALID;
+	phs->fw_started = 0;
+	sbi_memset(phs->fw_counters, 0, sizeof(phs->fw_counters));
+	phs->prof_started = 0;
+	sbi_memset(phs->prof_counters, 0, sizeof(phs->prof_counters));
 }
 
 void sbi_pmu_exit(struct sbi_scratch *scratch)
 {
-	u32 hartid = current_hartid();
-
 	if (sbi_hart_has_feature(scratch, SBI_HART_HAS_MCOUNTINHIBIT))
 		csr_write(CSR_MCOUNTINHIBIT, 0xFFFFFFF8);
 
 	csr_write(CSR_MCOUNTEREN, -1);
-	pmu_reset_event_map(hartid);
+	sbi_emulate_csr_update(scratch);
+	pmu_reset_event_map(pmu_get_hart_state(scratch));
 }
 
 int sbi_pmu_init(struct sbi_scratch *scratch, bool cold_boot)
 {
 	const struct sbi_platform *plat;
-	u32 hartid = current_hartid();
+	struct sbi_pmu_hart_state *phs;
 
 	if (cold_boot) {
+		pmu_hart_state_off = sbi_scratch_alloc_offset(
+				PMU_HART_STATE_SIZE + PMU_CACHE_LINE_SIZE);
+		if (!pmu_hart_state_off)
+			return SBI_ENOMEM;
+
 		plat = sbi_platform_ptr(scratch);
 		/* Initialize hw pmu events */
 		sbi_platform_pmu_init(plat);
@@ -738,16 +873,20 @@ int sbi_pmu_init(struct sbi_scratch *scratch, bool cold_boot)
 		/* mcycle & minstret is available always */
 		num_hw_ctrs = sbi_hart_mhpm_count(scratch) + 2;
 		total_ctrs = num_hw_ctrs + SBI_PMU_FW_CTR_MAX;
+	} else {
+		if (!pmu_hart_state_off)
+			return SBI_ENOMEM;
 	}
 
-	pmu_reset_event_map(hartid);
+	phs = pmu_get_hart_state(scratch);
+	pmu_reset_event_map(phs);
 
 	/* First three counters are fixed by the priv spec and we enable it by default */
-	active_events[hartid][0] = SBI_PMU_EVENT_TYPE_HW << SBI_PMU_EVENT_IDX_OFFSET |
-				   SBI_PMU_HW_CPU_CYCLES;
-	active_events[hartid][1] = SBI_PMU_EVENT_IDX_INVALID;
-	active_events[hartid][2] = SBI_PMU_EVENT_TYPE_HW << SBI_PMU_EVENT_IDX_OFFSET |
-				   SBI_PMU_HW_INSTRUCTIONS;
+	phs->active_events[0] = SBI_PMU_EVENT_TYPE_HW << SBI_PMU_EVENT_IDX_OFFSET |
+				SBI_PMU_HW_CPU_CYCLES;
+	phs->active_events[1] = SBI_PMU_EVENT_IDX_INVALID;
+	phs->active_events[2] = SBI_PMU_EVENT_TYPE_HW << SBI_PMU_EVENT_IDX_OFFSET |
+				SBI_PMU_HW_INSTRUCTIONS;
 
 	return 0;
 }
@@ -8,8 +8,9 @@
  */
 
 /*
- * Simple libc functions. These are not optimized at all and might have some
- * bugs as well. Use any optimized routines from newlib or glibc if required.
+ * Simple libc functions. Only the memory routines are optimized for word
+ * sized accesses, use any optimized routines from newlib or glibc if
+ * required.
  */
 
 #include <sbi/sbi_string.h>
@@ -110,9 +111,56 @@ char *sbi_strrchr(const char *s, int c)
 	else
 		return (char *)last;
 }
+
+/*
+ * The memory routines below work on naturally aligned machine words
+ * whenever the buffers allow it and fall back to byte accesses for the
+ * unaligned head and tail. We are built with -mstrict-align so word
+ * accesses are only used when both pointers share the same alignment,
+ * mutually misaligned buffers are handled one byte at a time.
+ */
+
+#define WORD_SIZE		sizeof(unsigned long)
+#define WORD_MASK		(WORD_SIZE - 1)
+
+static inline bool mutually_aligned(const void *a, const void *b)
+{
+	return !(((unsigned long)a ^ (unsigned long)b) & WORD_MASK);
+}
+
 void *sbi_memset(void *s, int c, size_t count)
 {
 	char *temp = s;
+	unsigned long *wtemp, pattern;
+
+	if (count >= WORD_SIZE) {
+		while ((unsigned long)temp & WORD_MASK) {
+			*temp++ = c;
+			count--;
+		}
+
+		pattern = (unsigned char)c;
+		pattern |= pattern << 8;
+		pattern |= pattern << 16;
+#if __riscv_xlen == 64
+		pattern |= pattern << 32;
+#endif
+
+		wtemp = (unsigned long *)temp;
+		while (count >= 4 * WORD_SIZE) {
+			wtemp[0] = pattern;
+			wtemp[1] = pattern;
+			wtemp[2] = pattern;
+			wtemp[3] = pattern;
+			wtemp += 4;
+			count -= 4 * WORD_SIZE;
+		}
+		while (count >= WORD_SIZE) {
+			*wtemp++ = pattern;
+			count -= WORD_SIZE;
+		}
+		temp = (char *)wtemp;
+	}
 
 	while (count > 0) {
 		count--;
@@ -126,6 +174,33 @@ void *sbi_memcpy(void *dest, const void *src, size_t count)
 {
 	char *temp1	  = dest;
 	const char *temp2 = src;
+	unsigned long *wtemp1;
+	const unsigned long *wtemp2;
+
+	if (count >= WORD_SIZE && mutually_aligned(temp1, temp2)) {
+		while ((unsigned long)temp1 & WORD_MASK) {
+			*temp1++ = *temp2++;
+			count--;
+		}
+
+		wtemp1 = (unsigned long *)temp1;
+		wtemp2 = (const unsigned long *)temp2;
+		while (count >= 4 * WORD_SIZE) {
+			wtemp1[0] = wtemp2[0];
+			wtemp1[1] = wtemp2[1];
+			wtemp1[2] = wtemp2[2];
+			wtemp1[3] = wtemp2[3];
+			wtemp1 += 4;
+			wtemp2 += 4;
+			count -= 4 * WORD_SIZE;
+		}
+		while (count >= WORD_SIZE) {
+			*wtemp1++ = *wtemp2++;
+			count -= WORD_SIZE;
+		}
+		temp1 = (char *)wtemp1;
+		temp2 = (const char *)wtemp2;
+	}
 
 	while (count > 0) {
 		*temp1++ = *temp2++;
@@ -139,23 +214,38 @@ void *sbi_memmove(void *dest, const void *src, size_t count)
 {
 	char *temp1	  = (char *)dest;
 	const char *temp2 = (char *)src;
+	unsigned long *wtemp1;
+	const unsigned long *wtemp2;
 
 	if (src == dest)
 		return dest;
 
-	if (dest < src) {
-		while (count > 0) {
-			*temp1++ = *temp2++;
+	/* Forward copy is safe unless dest overlaps the tail of src */
+	if (dest < src || temp1 >= temp2 + count)
+		return sbi_memcpy(dest, src, count);
+
+	temp1 = dest + count;
+	temp2 = src + count;
+
+	if (count >= WORD_SIZE && mutually_aligned(temp1, temp2)) {
+		while ((unsigned long)temp1 & WORD_MASK) {
+			*--temp1 = *--temp2;
 			count--;
 		}
-	} else {
-		temp1 = dest + count - 1;
-		temp2 = src + count - 1;
 
-		while (count > 0) {
-			*temp1-- = *temp2--;
-			count--;
+		wtemp1 = (unsigned long *)temp1;
+		wtemp2 = (const unsigned long *)temp2;
+		while (count >= WORD_SIZE) {
+			*--wtemp1 = *--wtemp2;
+			count -= WORD_SIZE;
 		}
+		temp1 = (char *)wtemp1;
+		temp2 = (const char *)wtemp2;
+	}
+
+	while (count > 0) {
+		*--temp1 = *--temp2;
+		count--;
 	}
 
 	return dest;
@@ -165,7 +255,30 @@ int sbi_memcmp(const void *s1, const void *s2, size_t count)
 {
 	const char *temp1 = s1;
 	const char *temp2 = s2;
+	const unsigned long *wtemp1, *wtemp2;
+
+	if (count >= WORD_SIZE && mutually_aligned(temp1, temp2)) {
+		while ((unsigned long)temp1 & WORD_MASK) {
+			if (*temp1 != *temp2)
+				goto done;
+			temp1++;
+			temp2++;
+			count--;
+		}
+
+		/* Skip equal words, the byte loop locates the difference */
+		wtemp1 = (const unsigned long *)temp1;
+		wtemp2 = (const unsigned long *)temp2;
+		while (count >= WORD_SIZE && *wtemp1 == *wtemp2) {
+			wtemp1++;
+			wtemp2++;
+			count -= WORD_SIZE;
+		}
+		temp1 = (const char *)wtemp1;
+		temp2 = (const char *)wtemp2;
+	}
 
+done:
 	for (; count > 0 && (*temp1 == *temp2); count--) {
 		temp1++;
 		temp2++;
@@ -18,7 +18,18 @@
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_timer.h>
 
+/** Per-HART queue of pending timer events */
+struct sbi_timer_queue {
+	/** Deadline requested by S-mode (-1ULL if none) */
+	u64 smode_deadline;
+	/** Number of firmware events in the heap */
+	unsigned long count;
+	/** Min-heap of firmware events ordered by deadline */
+	struct sbi_timer_event *heap[SBI_TIMER_EVENT_MAX];
+};
+
 static unsigned long time_delta_off;
+static unsigned long timer_queue_off;
 static u64 (*get_time_val)(void);
 static const struct sbi_timer_device *timer_dev = NULL;
 
@@ -121,19 +132,183 @@ void sbi_timer_set_delta_upper(ulong delta_upper)
 	*time_delta |= ((u64)delta_upper << 32);
 }
 
-void sbi_timer_event_start(u64 next_event)
+static void sbi_timer_stimecmp_write(u64 next_event)
 {
-	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_SET_TIMER);
+#if __riscv_xlen == 32
+	/* Avoid a spurious interrupt while updating the two halves */
+	csr_write(CSR_STIMECMP, -1UL);
+	csr_write(CSR_STIMECMPH, next_event >> 32);
+	csr_write(CSR_STIMECMP, next_event & 0xFFFFFFFF);
+#else
+	csr_write(CSR_STIMECMP, next_event);
+#endif
+}
+
+static void timer_heap_swap(struct sbi_timer_queue *q, unsigned long i,
+			    unsigned long j)
+{
+	struct sbi_timer_event *tmp = q->heap[i];
+
+	q->heap[i] = q->heap[j];
+	q->heap[j] = tmp;
+}
+
+static void timer_heap_up(struct sbi_timer_queue *q, unsigned long i)
+{
+	unsigned long parent;
+
+	while (i) {
+		parent = (i - 1) / 2;
+		if (q->heap[parent]->deadline <= q->heap[i]->deadline)
+			break;
+		timer_heap_swap(q, parent, i);
+		i = parent;
+	}
+}
+
+static void timer_heap_down(struct sbi_timer_queue *q, unsigned long i)
+{
+	unsigned long child;
+
+	while ((child = 2 * i + 1) < q->count) {
+		if ((child + 1) < q->count &&
+		    q->heap[child + 1]->deadline < q->heap[child]->deadline)
+			child++;
+		if (q->heap[i]->deadline <= q->heap[child]->deadline)
+			break;
+		timer_heap_swap(q, i, child);
+		i = child;
+	}
+}
+
+static void timer_heap_remove(struct sbi_timer_queue *q, unsigned long i)
+{
+	q->count--;
+	if (i == q->count)
+		return;
+
+	q->heap[i] = q->heap[q->count];
+	timer_heap_up(q, i);
+	timer_heap_down(q, i);
+}
+
+/* Program the M-mode timer for the earliest pending deadline */
+static void timer_queue_arm(struct sbi_timer_queue *q)
+{
+	u64 next_event = q->smode_deadline;
+
+	if (q->count && q->heap[0]->deadline < next_event)
+		next_event = q->heap[0]->deadline;
+
+	if (next_event == -1ULL) {
+		csr_clear(CSR_MIE, MIP_MTIP);
+		return;
+	}
+
 	if (timer_dev && timer_dev->timer_event_start)
 		timer_dev->timer_event_start(next_event);
-	csr_clear(CSR_MIP, MIP_STIP);
 	csr_set(CSR_MIE, MIP_MTIP);
 }
 
+int sbi_timer_event_add(struct sbi_timer_event *ev, u64 deadline)
+{
+	unsigned long i;
+	struct sbi_timer_queue *q;
+
+	if (!ev || !ev->callback)
+		return SBI_EINVAL;
+	/* Deadlines can't be told apart without a time source */
+	if (!timer_dev || !timer_dev->timer_event_start || !get_time_val)
+		return SBI_ENODEV;
+
+	q = sbi_scratch_thishart_offset_ptr(timer_queue_off);
+	for (i = 0; i < q->count; i++) {
+		if (q->heap[i] == ev)
+			return SBI_EALREADY;
+	}
+	if (SBI_TIMER_EVENT_MAX <= q->count)
+		return SBI_ENOSPC;
+
+	ev->deadline = deadline;
+	q->heap[q->count++] = ev;
+	timer_heap_up(q, q->count - 1);
+	timer_queue_arm(q);
+
+	return 0;
+}
+
+int sbi_timer_event_del(struct sbi_timer_event *ev)
+{
+	unsigned long i;
+	struct sbi_timer_queue *q;
+
+	if (!ev)
+		return SBI_EINVAL;
+
+	q = sbi_scratch_thishart_offset_ptr(timer_queue_off);
+	for (i = 0; i < q->count; i++) {
+		if (q->heap[i] == ev) {
+			timer_heap_remove(q, i);
+			timer_queue_arm(q);
+			return 0;
+		}
+	}
+
+	return SBI_ENOENT;
+}
+
+void sbi_timer_event_start(u64 next_event)
+{
+	struct sbi_timer_queue *q;
+
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_SET_TIMER);
+
+	/*
+	 * With Sstc the supervisor timer interrupt is raised by hardware
+	 * so older S-mode software calling set_timer doesn't need the
+	 * M-mode timer either.
+	 */
+	if (sbi_hart_has_feature(sbi_scratch_thishart_ptr(),
+				 SBI_HART_HAS_SSTC)) {
+		sbi_timer_stimecmp_write(next_event);
+		return;
+	}
+
+	q = sbi_scratch_thishart_offset_ptr(timer_queue_off);
+	q->smode_deadline = next_event;
+	csr_clear(CSR_MIP, MIP_STIP);
+	timer_queue_arm(q);
+}
+
 void sbi_timer_process(void)
 {
-	csr_clear(CSR_MIE, MIP_MTIP);
-	csr_set(CSR_MIP, MIP_STIP);
+	unsigned long budget;
+	struct sbi_timer_event *ev;
+	struct sbi_timer_queue *q =
+			sbi_scratch_thishart_offset_ptr(timer_queue_off);
+
+	/*
+	 * Run expired firmware events first. A callback may queue its
+	 * event again to get periodic behaviour. No more callbacks than
+	 * events queued on entry run here, so an event queued again with
+	 * a deadline already passed waits for the next interrupt instead
+	 * of keeping this HART in the loop.
+	 */
+	for (budget = q->count; budget && q->count; budget--) {
+		ev = q->heap[0];
+		if (sbi_timer_value() < ev->deadline)
+			break;
+		timer_heap_remove(q, 0);
+		ev->callback(ev);
+	}
+
+	/* Forward the interrupt to S-mode only once its deadline passed */
+	if (q->smode_deadline <= sbi_timer_value()) {
+		q->smode_deadline = -1ULL;
+		csr_set(CSR_MIP, MIP_STIP);
+	}
+
+	timer_queue_arm(q);
 }
 
 const struct sbi_timer_device *sbi_timer_get_device(void)
@@ -154,6 +329,7 @@ void sbi_timer_set_device(const struct sbi_timer_device *dev)
 int sbi_timer_init(struct sbi_scratch *scratch, bool cold_boot)
 {
 	u64 *time_delta;
+	struct sbi_timer_queue *q;
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
 
 	if (cold_boot) {
@@ -161,24 +337,42 @@ int sbi_timer_init(struct sbi_scratch *scratch, bool cold_boot)
 		if (!time_delta_off)
 			return SBI_ENOMEM;
 
+		timer_queue_off = sbi_scratch_alloc_offset(sizeof(*q));
+		if (!timer_queue_off)
+			return SBI_ENOMEM;
+
 		if (sbi_hart_has_feature(scratch, SBI_HART_HAS_TIME))
 			get_time_val = get_ticks;
 	} else {
-		if (!time_delta_off)
+		if (!time_delta_off || !timer_queue_off)
 			return SBI_ENOMEM;
 	}
 
 	time_delta = sbi_scratch_offset_ptr(scratch, time_delta_off);
 	*time_delta = 0;
 
+	q = sbi_scratch_offset_ptr(scratch, timer_queue_off);
+	q->smode_deadline = -1ULL;
+	q->count = 0;
+
 	return sbi_platform_timer_init(plat, cold_boot);
 }
 
 void sbi_timer_exit(struct sbi_scratch *scratch)
 {
+	struct sbi_timer_queue *q = sbi_scratch_offset_ptr(scratch,
+							   timer_queue_off);
+
+	/* Pending events of a stopped HART are dropped */
+	q->smode_deadline = -1ULL;
+	q->count = 0;
+
 	if (timer_dev && timer_dev->timer_event_stop)
 		timer_dev->timer_event_stop();
 
+	if (sbi_hart_has_feature(scratch, SBI_HART_HAS_SSTC))
+		sbi_timer_stimecmp_write(-1ULL);
+
 	csr_clear(CSR_MIP, MIP_STIP);
 	csr_clear(CSR_MIE, MIP_MTIP);
 
@@ -12,7 +12,6 @@
 #include <sbi/riscv_atomic.h>
 #include <sbi/riscv_barrier.h>
 #include <sbi/sbi_error.h>
-#include <sbi/sbi_fifo.h>
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_ipi.h>
 #include <sbi/sbi_scratch.h>
@@ -24,368 +23,488 @@
 #include <sbi/sbi_pmu.h>
 
 static unsigned long tlb_sync_off;
-static unsigned long tlb_fifo_off;
-static unsigned long tlb_fifo_mem_off;
-static unsigned long tlb_range_flush_limit;
+static unsigned long tlb_pending_off;
+static unsigned long tlb_slot_off;
+static unsigned long tlb_range_flush_limit[SBI_TLB_FENCE_MAX];
+
+/* Pages fenced one by one when timing a ranged fence */
+#define TLB_CALIBRATE_PAGES		32
+/* Timing rounds, the fastest round is kept */
+#define TLB_CALIBRATE_ROUNDS		4
+/*
+ * Tunable: cycles charged to a full flush for S-mode refilling the
+ * TLB entries it dropped. This is a fixed estimate and not measured,
+ * because no S-mode page table exists at cold boot. Platforms where
+ * it is far off should return fixed limits or set them with the
+ * /chosen/opensbi,tlb-range-flush-limits DT property.
+ */
+#define TLB_CALIBRATE_REFILL_CYCLES	2048
+/* Largest calibrated limit, the span of one last level page table */
+#define TLB_CALIBRATE_LIMIT_MAX		(512 * PAGE_SIZE)
+
+/* Fences kept in the pending work summary of a HART */
+#define TLB_SUMMARY_MAX			16
+
+/**
+ * Canonical form of one fence request
+ *
+ * An ASID or VMID marked "any" matches every context, and a full fence
+ * covers the whole address space of its context, so every local fence
+ * flavour is one point of the same (type, context, range) space and
+ * one fence covering another makes the covered one redundant.
+ */
+struct tlb_fence {
+	unsigned long start;
+	unsigned long end;
+	unsigned long asid;
+	unsigned long vmid;
+	u8 type;
+	bool any_asid;
+	bool any_vmid;
+	bool full;
+};
+
+/** Pending work of a HART reduced to the fences it really needs */
+struct tlb_summary {
+	bool fence_i;
+	u32 count;
+	struct tlb_fence fence[TLB_SUMMARY_MAX];
+};
 
 static void tlb_flush_all(void)
 {
 	__asm__ __volatile("sfence.vma");
 }
 
-void sbi_tlb_local_hfence_vvma(struct sbi_tlb_info *tinfo)
+/*
+ * With Svinval the per-page invalidations of a range are not ordered
+ * against each other, only the SFENCE.W.INVAL and SFENCE.INVAL.IR pair
+ * around the whole range orders them against memory accesses.
+ */
+static bool tlb_has_svinval(void)
 {
-	unsigned long start = tinfo->start;
-	unsigned long size  = tinfo->size;
-	unsigned long vmid  = tinfo->vmid;
-	unsigned long i, hgatp;
-
-	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_HFENCE_VVMA_RCVD);
-
-	hgatp = csr_swap(CSR_HGATP,
-			 (vmid << HGATP_VMID_SHIFT) & HGATP_VMID_MASK);
-
-	if ((start == 0 && size == 0) || (size == SBI_TLB_FLUSH_ALL)) {
-		__sbi_hfence_vvma_all();
-		goto done;
-	}
-
-	for (i = 0; i < size; i += PAGE_SIZE) {
-		__sbi_hfence_vvma_va(start+i);
-	}
-
-done:
-	csr_write(CSR_HGATP, hgatp);
+	return sbi_hart_has_feature(sbi_scratch_thishart_ptr(),
+				    SBI_HART_HAS_SVINVAL);
 }
 
-void sbi_tlb_local_hfence_gvma(struct sbi_tlb_info *tinfo)
+static enum sbi_tlb_fence_type tlb_fence_type(struct sbi_tlb_info *tinfo)
 {
-	unsigned long start = tinfo->start;
-	unsigned long size  = tinfo->size;
-	unsigned long i;
-
-	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_HFENCE_GVMA_RCVD);
-
-	if ((start == 0 && size == 0) || (size == SBI_TLB_FLUSH_ALL)) {
-		__sbi_hfence_gvma_all();
-		return;
+	switch (tinfo->type) {
+	case SBI_TLB_HFENCE_VVMA:
+	case SBI_TLB_HFENCE_VVMA_ASID:
+		return SBI_TLB_FENCE_VS;
+	case SBI_TLB_HFENCE_GVMA:
+	case SBI_TLB_HFENCE_GVMA_VMID:
+		return SBI_TLB_FENCE_G;
+	default:
+		return SBI_TLB_FENCE_S;
 	}
+}
 
-	for (i = 0; i < size; i += PAGE_SIZE) {
-		__sbi_hfence_gvma_gpa((start + i) >> 2);
+static void tlb_fence_from_info(struct tlb_fence *f,
+				struct sbi_tlb_info *tinfo)
+{
+	f->type = tlb_fence_type(tinfo);
+	f->asid = tinfo->asid;
+	f->vmid = tinfo->vmid;
+	f->any_asid = tinfo->type != SBI_TLB_SFENCE_VMA_ASID &&
+		      tinfo->type != SBI_TLB_HFENCE_VVMA_ASID;
+	f->any_vmid = tinfo->type == SBI_TLB_SFENCE_VMA ||
+		      tinfo->type == SBI_TLB_SFENCE_VMA_ASID ||
+		      tinfo->type == SBI_TLB_HFENCE_GVMA;
+	f->full = false;
+	f->start = tinfo->start;
+	f->end = tinfo->start + tinfo->size;
+	if (f->end < f->start)
+		f->end = -1UL;
+
+	if (tinfo->start == 0 && tinfo->size == 0) {
+		/* Flush everything, VS-stage stays within the VMID */
+		f->any_asid = true;
+		if (f->type != SBI_TLB_FENCE_VS)
+			f->any_vmid = true;
+		f->full = true;
+	} else if (tinfo->size == SBI_TLB_FLUSH_ALL) {
+		f->full = true;
 	}
 }
 
-void sbi_tlb_local_sfence_vma(struct sbi_tlb_info *tinfo)
+static void tlb_fence_exec_s(const struct tlb_fence *f)
 {
-	unsigned long start = tinfo->start;
-	unsigned long size  = tinfo->size;
-	unsigned long i;
-
-	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_SFENCE_VMA_RCVD);
-
-	if ((start == 0 && size == 0) || (size == SBI_TLB_FLUSH_ALL)) {
-		tlb_flush_all();
+	unsigned long i, size = f->end - f->start;
+	bool svinval;
+
+	if (f->full) {
+		if (f->any_asid)
+			tlb_flush_all();
+		else
+			__asm__ __volatile__("sfence.vma x0, %0"
+					     :
+					     : "r"(f->asid)
+					     : "memory");
 		return;
 	}
 
+	svinval = tlb_has_svinval();
+	if (svinval)
+		__sbi_sfence_w_inval();
 	for (i = 0; i < size; i += PAGE_SIZE) {
-		__asm__ __volatile__("sfence.vma %0"
-				     :
-				     : "r"(start + i)
-				     : "memory");
+		if (svinval && f->any_asid)
+			__sbi_sinval_vma_va(f->start + i);
+		else if (svinval)
+			__sbi_sinval_vma_asid_va(f->start + i, f->asid);
+		else if (f->any_asid)
+			__asm__ __volatile__("sfence.vma %0"
+					     :
+					     : "r"(f->start + i)
+					     : "memory");
+		else
+			__asm__ __volatile__("sfence.vma %0, %1"
+					     :
+					     : "r"(f->start + i), "r"(f->asid)
+					     : "memory");
 	}
+	if (svinval)
+		__sbi_sfence_inval_ir();
 }
 
-void sbi_tlb_local_hfence_vvma_asid(struct sbi_tlb_info *tinfo)
+static void tlb_fence_exec_vs(const struct tlb_fence *f)
 {
-	unsigned long start = tinfo->start;
-	unsigned long size  = tinfo->size;
-	unsigned long asid  = tinfo->asid;
-	unsigned long vmid  = tinfo->vmid;
-	unsigned long i, hgatp;
-
-	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_HFENCE_VVMA_ASID_RCVD);
+	unsigned long i, hgatp, size = f->end - f->start;
+	bool svinval;
 
 	hgatp = csr_swap(CSR_HGATP,
-			 (vmid << HGATP_VMID_SHIFT) & HGATP_VMID_MASK);
-
-	if (start == 0 && size == 0) {
-		__sbi_hfence_vvma_all();
-		goto done;
-	}
+			 (f->vmid << HGATP_VMID_SHIFT) & HGATP_VMID_MASK);
 
-	if (size == SBI_TLB_FLUSH_ALL) {
-		__sbi_hfence_vvma_asid(asid);
+	if (f->full) {
+		if (f->any_asid)
+			__sbi_hfence_vvma_all();
+		else
+			__sbi_hfence_vvma_asid(f->asid);
 		goto done;
 	}
 
+	svinval = tlb_has_svinval();
+	if (svinval)
+		__sbi_sfence_w_inval();
 	for (i = 0; i < size; i += PAGE_SIZE) {
-		__sbi_hfence_vvma_asid_va(start + i, asid);
+		if (svinval && f->any_asid)
+			__sbi_hinval_vvma_va(f->start + i);
+		else if (svinval)
+			__sbi_hinval_vvma_asid_va(f->start + i, f->asid);
+		else if (f->any_asid)
+			__sbi_hfence_vvma_va(f->start + i);
+		else
+			__sbi_hfence_vvma_asid_va(f->start + i, f->asid);
 	}
+	if (svinval)
+		__sbi_sfence_inval_ir();
 
 done:
 	csr_write(CSR_HGATP, hgatp);
 }
 
-void sbi_tlb_local_hfence_gvma_vmid(struct sbi_tlb_info *tinfo)
+static void tlb_fence_exec_g(const struct tlb_fence *f)
 {
-	unsigned long start = tinfo->start;
-	unsigned long size  = tinfo->size;
-	unsigned long vmid  = tinfo->vmid;
-	unsigned long i;
-
-	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_HFENCE_GVMA_VMID_RCVD);
-
-	if (start == 0 && size == 0) {
-		__sbi_hfence_gvma_all();
-		return;
-	}
-
-	if (size == SBI_TLB_FLUSH_ALL) {
-		__sbi_hfence_gvma_vmid(vmid);
+	unsigned long i, size = f->end - f->start;
+	bool svinval;
+
+	if (f->full) {
+		if (f->any_vmid)
+			__sbi_hfence_gvma_all();
+		else
+			__sbi_hfence_gvma_vmid(f->vmid);
 		return;
 	}
 
+	svinval = tlb_has_svinval();
+	if (svinval)
+		__sbi_sfence_w_inval();
 	for (i = 0; i < size; i += PAGE_SIZE) {
-		__sbi_hfence_gvma_vmid_gpa((start + i) >> 2, vmid);
+		if (svinval && f->any_vmid)
+			__sbi_hinval_gvma_gpa((f->start + i) >> 2);
+		else if (svinval)
+			__sbi_hinval_gvma_vmid_gpa((f->start + i) >> 2,
+						   f->vmid);
+		else if (f->any_vmid)
+			__sbi_hfence_gvma_gpa((f->start + i) >> 2);
+		else
+			__sbi_hfence_gvma_vmid_gpa((f->start + i) >> 2,
+						   f->vmid);
 	}
+	if (svinval)
+		__sbi_sfence_inval_ir();
 }
 
-void sbi_tlb_local_sfence_vma_asid(struct sbi_tlb_info *tinfo)
+static void tlb_fence_exec(const struct tlb_fence *f)
 {
-	unsigned long start = tinfo->start;
-	unsigned long size  = tinfo->size;
-	unsigned long asid  = tinfo->asid;
-	unsigned long i;
+	if (f->type == SBI_TLB_FENCE_VS)
+		tlb_fence_exec_vs(f);
+	else if (f->type == SBI_TLB_FENCE_G)
+		tlb_fence_exec_g(f);
+	else
+		tlb_fence_exec_s(f);
+}
 
-	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_SFENCE_VMA_ASID_RCVD);
+static const u32 tlb_fw_sent[SBI_TLB_TYPE_MAX] = {
+	[SBI_TLB_TYPE_FENCE_I] = SBI_PMU_FW_FENCE_I_SENT,
+	[SBI_TLB_SFENCE_VMA] = SBI_PMU_FW_SFENCE_VMA_SENT,
+	[SBI_TLB_SFENCE_VMA_ASID] = SBI_PMU_FW_SFENCE_VMA_ASID_SENT,
+	[SBI_TLB_HFENCE_GVMA_VMID] = SBI_PMU_FW_HFENCE_GVMA_VMID_SENT,
+	[SBI_TLB_HFENCE_GVMA] = SBI_PMU_FW_HFENCE_GVMA_SENT,
+	[SBI_TLB_HFENCE_VVMA_ASID] = SBI_PMU_FW_HFENCE_VVMA_ASID_SENT,
+	[SBI_TLB_HFENCE_VVMA] = SBI_PMU_FW_HFENCE_VVMA_SENT,
+};
 
-	if (start == 0 && size == 0) {
-		tlb_flush_all();
-		return;
-	}
+static const u32 tlb_fw_rcvd[SBI_TLB_TYPE_MAX] = {
+	[SBI_TLB_TYPE_FENCE_I] = SBI_PMU_FW_FENCE_I_RECVD,
+	[SBI_TLB_SFENCE_VMA] = SBI_PMU_FW_SFENCE_VMA_RCVD,
+	[SBI_TLB_SFENCE_VMA_ASID] = SBI_PMU_FW_SFENCE_VMA_ASID_RCVD,
+	[SBI_TLB_HFENCE_GVMA_VMID] = SBI_PMU_FW_HFENCE_GVMA_VMID_RCVD,
+	[SBI_TLB_HFENCE_GVMA] = SBI_PMU_FW_HFENCE_GVMA_RCVD,
+	[SBI_TLB_HFENCE_VVMA_ASID] = SBI_PMU_FW_HFENCE_VVMA_ASID_RCVD,
+	[SBI_TLB_HFENCE_VVMA] = SBI_PMU_FW_HFENCE_VVMA_RCVD,
+};
+
+/** Execute one request on the current HART without coalescing */
+static void tlb_local_fence(struct sbi_tlb_info *tinfo)
+{
+	struct tlb_fence f;
 
-	/* Flush entire MM context for a given ASID */
-	if (size == SBI_TLB_FLUSH_ALL) {
-		__asm__ __volatile__("sfence.vma x0, %0"
-				     :
-				     : "r"(asid)
-				     : "memory");
+	sbi_pmu_ctr_incr_fw(tlb_fw_rcvd[tinfo->type]);
+
+	if (tinfo->type == SBI_TLB_TYPE_FENCE_I) {
+		__asm__ __volatile("fence.i");
 		return;
 	}
 
-	for (i = 0; i < size; i += PAGE_SIZE) {
-		__asm__ __volatile__("sfence.vma %0, %1"
-				     :
-				     : "r"(start + i), "r"(asid)
-				     : "memory");
-	}
+	tlb_fence_from_info(&f, tinfo);
+	tlb_fence_exec(&f);
 }
 
-void sbi_tlb_local_fence_i(struct sbi_tlb_info *tinfo)
+/** Check whether fence a invalidates everything fence b does */
+static bool tlb_fence_covers(const struct tlb_fence *a,
+			     const struct tlb_fence *b)
 {
-	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_FENCE_I_RECVD);
-
-	__asm__ __volatile("fence.i");
+	if (a->type != b->type)
+		return false;
+	if (!a->any_asid && (b->any_asid || a->asid != b->asid))
+		return false;
+	if (!a->any_vmid && (b->any_vmid || a->vmid != b->vmid))
+		return false;
+	if (a->full)
+		return true;
+
+	return !b->full && a->start <= b->start && b->end <= a->end;
 }
 
-static void tlb_pmu_incr_fw_ctr(struct sbi_tlb_info *data)
+/** Check whether two ranged fences of one context overlap or touch */
+static bool tlb_fence_mergeable(const struct tlb_fence *a,
+				const struct tlb_fence *b)
 {
-	if (unlikely(!data))
-		return;
-
-	if (data->local_fn == sbi_tlb_local_fence_i)
-		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_FENCE_I_SENT);
-	else if (data->local_fn == sbi_tlb_local_sfence_vma)
-		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_SFENCE_VMA_SENT);
-	else if (data->local_fn == sbi_tlb_local_sfence_vma_asid)
-		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_SFENCE_VMA_ASID_SENT);
-	else if (data->local_fn == sbi_tlb_local_hfence_gvma)
-		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_HFENCE_GVMA_SENT);
-	else if (data->local_fn == sbi_tlb_local_hfence_gvma_vmid)
-		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_HFENCE_GVMA_VMID_SENT);
-	else if (data->local_fn == sbi_tlb_local_hfence_vvma)
-		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_HFENCE_VVMA_SENT);
-	else if (data->local_fn == sbi_tlb_local_hfence_vvma_asid)
-		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_HFENCE_VVMA_ASID_SENT);
+	if (a->type != b->type || a->full || b->full)
+		return false;
+	if (a->any_asid != b->any_asid ||
+	    (!a->any_asid && a->asid != b->asid))
+		return false;
+	if (a->any_vmid != b->any_vmid ||
+	    (!a->any_vmid && a->vmid != b->vmid))
+		return false;
+
+	return a->start <= b->end && b->start <= a->end;
 }
 
-static void tlb_entry_process(struct sbi_tlb_info *tinfo)
+static void tlb_summary_flush(struct tlb_summary *sum)
 {
-	u32 rhartid;
-	struct sbi_scratch *rscratch = NULL;
-	unsigned long *rtlb_sync = NULL;
+	u32 i;
+
+	for (i = 0; i < sum->count; i++)
+		tlb_fence_exec(&sum->fence[i]);
+	if (sum->fence_i)
+		__asm__ __volatile("fence.i");
 
-	tinfo->local_fn(tinfo);
+	sum->count = 0;
+	sum->fence_i = false;
+}
 
-	sbi_hartmask_for_each_hart(rhartid, &tinfo->smask) {
-		rscratch = sbi_hartid_to_scratch(rhartid);
-		if (!rscratch)
+/**
+ * Add one fence to the summary.
+ *
+ * The new fence is dropped when an existing fence covers it, absorbs
+ * the existing fences it covers and is merged with the ranges of the
+ * same context it overlaps. A merged range above the range flush limit
+ * of its type becomes a full fence of its context, exactly like the
+ * sender does for a single request.
+ */
+static void tlb_summary_add(struct tlb_summary *sum, struct tlb_fence *f)
+{
+	u32 i;
+	struct tlb_fence *x;
+
+again:
+	if (!f->full && f->end - f->start > tlb_range_flush_limit[f->type])
+		f->full = true;
+
+	for (i = 0; i < sum->count; i++) {
+		x = &sum->fence[i];
+		if (tlb_fence_covers(x, f))
+			return;
+		if (!tlb_fence_covers(f, x) && !tlb_fence_mergeable(f, x))
 			continue;
 
-		rtlb_sync = sbi_scratch_offset_ptr(rscratch, tlb_sync_off);
-		while (atomic_raw_xchg_ulong(rtlb_sync, 1)) ;
+		if (!f->full) {
+			f->start = (x->start < f->start) ? x->start : f->start;
+			f->end = (f->end < x->end) ? x->end : f->end;
+		}
+		*x = sum->fence[--sum->count];
+		goto again;
 	}
+
+	if (sum->count == TLB_SUMMARY_MAX)
+		tlb_summary_flush(sum);
+	sum->fence[sum->count++] = *f;
 }
 
-static void tlb_process_count(struct sbi_scratch *scratch, int count)
+static void tlb_summary_add_info(struct tlb_summary *sum,
+				 struct sbi_tlb_info *tinfo)
 {
-	struct sbi_tlb_info tinfo;
-	unsigned int deq_count = 0;
-	struct sbi_fifo *tlb_fifo =
-			sbi_scratch_offset_ptr(scratch, tlb_fifo_off);
+	struct tlb_fence f;
 
-	while (!sbi_fifo_dequeue(tlb_fifo, &tinfo)) {
-		tlb_entry_process(&tinfo);
-		deq_count++;
-		if (deq_count > count)
-			break;
+	sbi_pmu_ctr_incr_fw(tlb_fw_rcvd[tinfo->type]);
 
+	if (tinfo->type == SBI_TLB_TYPE_FENCE_I) {
+		sum->fence_i = true;
+		return;
 	}
+
+	tlb_fence_from_info(&f, tinfo);
+	tlb_summary_add(sum, &f);
 }
 
-static void tlb_process(struct sbi_scratch *scratch)
+/** Report completion of a request to its sender */
+static void tlb_entry_done(struct sbi_tlb_info *tinfo)
 {
-	struct sbi_tlb_info tinfo;
-	struct sbi_fifo *tlb_fifo =
-			sbi_scratch_offset_ptr(scratch, tlb_fifo_off);
+	struct sbi_scratch *rscratch;
+	atomic_t *rtlb_sync;
 
-	while (!sbi_fifo_dequeue(tlb_fifo, &tinfo))
-		tlb_entry_process(&tinfo);
+	rscratch = sbi_hartid_to_scratch(tinfo->src_hart);
+	if (!rscratch)
+		return;
+
+	rtlb_sync = sbi_scratch_offset_ptr(rscratch, tlb_sync_off);
+	atomic_sub_return(rtlb_sync, 1);
 }
 
-static void tlb_sync(struct sbi_scratch *scratch)
+/**
+ * Consume all pending requests of the current HART.
+ *
+ * Every source HART owns exactly one request slot in its own scratch space
+ * and a source HART has at most one request in flight at any time because
+ * it waits for completion before reusing the slot. A request is posted by
+ * atomically setting the bit of the source HART in the pending mask of the
+ * target HART, so producers never contend on a lock and the consumer only
+ * needs one atomic exchange per word of the pending mask.
+ *
+ * All requests taken by one exchange are first reduced to a summary and
+ * only then executed, so duplicate, overlapping and covered fences cost
+ * one fence in total. The sources are released after the summary has
+ * been executed because their slots are read until then.
+ */
+static void tlb_process(struct sbi_scratch *scratch)
 {
-	unsigned long *tlb_sync =
-			sbi_scratch_offset_ptr(scratch, tlb_sync_off);
+	u32 i, rhartid;
+	unsigned long m, bits;
+	struct sbi_scratch *rscratch;
+	struct tlb_summary sum = { .fence_i = false, .count = 0 };
+	struct sbi_hartmask *tlb_pending =
+			sbi_scratch_offset_ptr(scratch, tlb_pending_off);
+
+	for (i = 0; i < BITS_TO_LONGS(SBI_HARTMASK_MAX_BITS); i++) {
+		if (!tlb_pending->bits[i])
+			continue;
 
-	while (!atomic_raw_xchg_ulong(tlb_sync, 0)) {
-		/*
-		 * While we are waiting for remote hart to set the sync,
-		 * consume fifo requests to avoid deadlock.
-		 */
-		tlb_process_count(scratch, 1);
-	}
+		bits = atomic_raw_xchg_ulong(&tlb_pending->bits[i], 0);
+		for (rhartid = i * BITS_PER_LONG, m = bits; m;
+		     rhartid++, m >>= 1) {
+			if (!(m & 1UL))
+				continue;
 
-	return;
-}
+			rscratch = sbi_hartid_to_scratch(rhartid);
+			if (!rscratch)
+				continue;
 
-static inline int tlb_range_check(struct sbi_tlb_info *curr,
-					struct sbi_tlb_info *next)
-{
-	unsigned long curr_end;
-	unsigned long next_end;
-	int ret = SBI_FIFO_UNCHANGED;
-
-	if (!curr || !next)
-		return ret;
-
-	next_end = next->start + next->size;
-	curr_end = curr->start + curr->size;
-	if (next->start <= curr->start && next_end > curr_end) {
-		curr->start = next->start;
-		curr->size  = next->size;
-		sbi_hartmask_or(&curr->smask, &curr->smask, &next->smask);
-		ret = SBI_FIFO_UPDATED;
-	} else if (next->start >= curr->start && next_end <= curr_end) {
-		sbi_hartmask_or(&curr->smask, &curr->smask, &next->smask);
-		ret = SBI_FIFO_SKIP;
-	}
+			tlb_summary_add_info(&sum,
+				sbi_scratch_offset_ptr(rscratch, tlb_slot_off));
+		}
+
+		tlb_summary_flush(&sum);
+
+		for (rhartid = i * BITS_PER_LONG, m = bits; m;
+		     rhartid++, m >>= 1) {
+			if (!(m & 1UL))
+				continue;
 
-	return ret;
+			rscratch = sbi_hartid_to_scratch(rhartid);
+			if (!rscratch)
+				continue;
+
+			tlb_entry_done(sbi_scratch_offset_ptr(rscratch,
+							      tlb_slot_off));
+		}
+	}
 }
 
 /**
- * Call back to decide if an inplace fifo update is required or next entry can
- * can be skipped. Here are the different cases that are being handled.
+ * Wait for all remote harts targeted by the current request.
  *
- * Case1:
- *	if next flush request range lies within one of the existing entry, skip
- *	the next entry.
- * Case2:
- *	if flush request range in current fifo entry lies within next flush
- *	request, update the current entry.
- *
- * Note:
- *	We can not issue a fifo reset anymore if a complete vma flush is requested.
- *	This is because we are queueing FENCE.I requests as well now.
- *	To ease up the pressure in enqueue/fifo sync path, try to dequeue 1 element
- *	before continuing the while loop. This method is preferred over wfi/ipi because
- *	of MMIO cost involved in later method.
+ * The sync counter of the source hart is incremented once per target
+ * in tlb_update() and each target decrements it after completing the
+ * request, so the source waits for the whole fan-out only once.
  */
-static int tlb_update_cb(void *in, void *data)
+static void tlb_sync(struct sbi_scratch *scratch)
 {
-	struct sbi_tlb_info *curr;
-	struct sbi_tlb_info *next;
-	int ret = SBI_FIFO_UNCHANGED;
-
-	if (!in || !data)
-		return ret;
-
-	curr = (struct sbi_tlb_info *)data;
-	next = (struct sbi_tlb_info *)in;
-
-	if (next->local_fn == sbi_tlb_local_sfence_vma_asid &&
-	    curr->local_fn == sbi_tlb_local_sfence_vma_asid) {
-		if (next->asid == curr->asid)
-			ret = tlb_range_check(curr, next);
-	} else if (next->local_fn == sbi_tlb_local_sfence_vma &&
-		   curr->local_fn == sbi_tlb_local_sfence_vma) {
-		ret = tlb_range_check(curr, next);
+	atomic_t *tlb_sync =
+			sbi_scratch_offset_ptr(scratch, tlb_sync_off);
+
+	while (atomic_read(tlb_sync) > 0) {
+		/*
+		 * While we are waiting for remote harts to complete,
+		 * consume pending requests to avoid deadlock.
+		 */
+		tlb_process(scratch);
 	}
 
-	return ret;
+	return;
 }
 
 static int tlb_update(struct sbi_scratch *scratch,
 			  struct sbi_scratch *remote_scratch,
 			  u32 remote_hartid, void *data)
 {
-	int ret;
-	struct sbi_fifo *tlb_fifo_r;
+	atomic_t *tlb_sync;
+	struct sbi_hartmask *tlb_pending_r;
 	struct sbi_tlb_info *tinfo = data;
 	u32 curr_hartid = current_hartid();
 
-	/*
-	 * If address range to flush is too big then simply
-	 * upgrade it to flush all because we can only flush
-	 * 4KB at a time.
-	 */
-	if (tinfo->size > tlb_range_flush_limit) {
-		tinfo->start = 0;
-		tinfo->size = SBI_TLB_FLUSH_ALL;
-	}
-
 	/*
 	 * If the request is to queue a tlb flush entry for itself
 	 * then just do a local flush and return;
 	 */
 	if (remote_hartid == curr_hartid) {
-		tinfo->local_fn(tinfo);
+		tlb_local_fence(tinfo);
 		return -1;
 	}
 
-	tlb_fifo_r = sbi_scratch_offset_ptr(remote_scratch, tlb_fifo_off);
-
-	ret = sbi_fifo_inplace_update(tlb_fifo_r, data, tlb_update_cb);
-	if (ret != SBI_FIFO_UNCHANGED) {
-		return 1;
-	}
+	/*
+	 * The request is already published in our own slot so only
+	 * mark it pending on the remote hart. The AMO has release
+	 * semantics hence the slot contents are visible before the bit.
+	 */
+	tlb_sync = sbi_scratch_offset_ptr(scratch, tlb_sync_off);
+	atomic_add_return(tlb_sync, 1);
 
-	while (sbi_fifo_enqueue(tlb_fifo_r, data) < 0) {
-		/**
-		 * For now, Busy loop until there is space in the fifo.
-		 * There may be case where target hart is also
-		 * enqueue in source hart's fifo. Both hart may busy
-		 * loop leading to a deadlock.
-		 * TODO: Introduce a wait/wakeup event mechanism to handle
-		 * this properly.
-		 */
-		tlb_process_count(scratch, 1);
-		sbi_dprintf("hart%d: hart%d tlb fifo full\n",
-			    curr_hartid, remote_hartid);
-	}
+	tlb_pending_r = sbi_scratch_offset_ptr(remote_scratch, tlb_pending_off);
+	atomic_raw_set_bit(curr_hartid, sbi_hartmask_bits(tlb_pending_r));
 
 	return 0;
 }
@@ -399,66 +518,205 @@ static struct sbi_ipi_event_ops tlb_ops = {
 
 static u32 tlb_event = SBI_IPI_EVENT_MAX;
 
+unsigned long sbi_tlb_range_flush_limit(enum sbi_tlb_fence_type type)
+{
+	if (SBI_TLB_FENCE_MAX <= type)
+		return 0;
+
+	return tlb_range_flush_limit[type];
+}
+
+void sbi_tlb_set_range_flush_limit(enum sbi_tlb_fence_type type,
+				   unsigned long limit)
+{
+	if (SBI_TLB_FENCE_MAX <= type)
+		return;
+
+	tlb_range_flush_limit[type] = limit;
+}
+
+/**
+ * Time a full fence (pages == 0) or a ranged fence of the given
+ * number of pages of the given type on the current HART.
+ */
+static unsigned long tlb_calibrate_cycles(enum sbi_tlb_fence_type type,
+					  unsigned long pages)
+{
+	bool svinval = pages && tlb_has_svinval();
+	unsigned long i, start = csr_read(CSR_MCYCLE);
+
+	if (svinval) {
+		__sbi_sfence_w_inval();
+		for (i = 0; i < pages; i++) {
+			if (type == SBI_TLB_FENCE_S)
+				__sbi_sinval_vma_va(i * PAGE_SIZE);
+			else if (type == SBI_TLB_FENCE_VS)
+				__sbi_hinval_vvma_va(i * PAGE_SIZE);
+			else
+				__sbi_hinval_gvma_gpa((i * PAGE_SIZE) >> 2);
+		}
+		__sbi_sfence_inval_ir();
+		return csr_read(CSR_MCYCLE) - start;
+	}
+
+	switch (type) {
+	case SBI_TLB_FENCE_S:
+		if (!pages)
+			tlb_flush_all();
+		for (i = 0; i < pages; i++)
+			__asm__ __volatile__("sfence.vma %0"
+					     :
+					     : "r"(i * PAGE_SIZE)
+					     : "memory");
+		break;
+	case SBI_TLB_FENCE_VS:
+		if (!pages)
+			__sbi_hfence_vvma_all();
+		for (i = 0; i < pages; i++)
+			__sbi_hfence_vvma_va(i * PAGE_SIZE);
+		break;
+	default:
+		if (!pages)
+			__sbi_hfence_gvma_all();
+		for (i = 0; i < pages; i++)
+			__sbi_hfence_gvma_gpa((i * PAGE_SIZE) >> 2);
+		break;
+	}
+
+	return csr_read(CSR_MCYCLE) - start;
+}
+
+/**
+ * Find the range size up to which fencing page by page is cheaper
+ * than a full flush followed by the refill of the dropped entries.
+ */
+static unsigned long tlb_calibrate_limit(enum sbi_tlb_fence_type type)
+{
+	unsigned long r, c, pages;
+	unsigned long range_cycles = -1UL, all_cycles = -1UL;
+
+	for (r = 0; r < TLB_CALIBRATE_ROUNDS; r++) {
+		c = tlb_calibrate_cycles(type, TLB_CALIBRATE_PAGES);
+		if (c < range_cycles)
+			range_cycles = c;
+		c = tlb_calibrate_cycles(type, 0);
+		if (c < all_cycles)
+			all_cycles = c;
+	}
+
+	/* Cycle counter not counting */
+	if (!range_cycles)
+		return SBI_PLATFORM_TLB_RANGE_FLUSH_LIMIT_DEFAULT;
+
+	pages = (all_cycles + TLB_CALIBRATE_REFILL_CYCLES) *
+		TLB_CALIBRATE_PAGES / range_cycles;
+	if (!pages)
+		pages = 1;
+
+	return (pages * PAGE_SIZE < TLB_CALIBRATE_LIMIT_MAX) ?
+		pages * PAGE_SIZE : TLB_CALIBRATE_LIMIT_MAX;
+}
+
+static void tlb_calibrate(void)
+{
+	unsigned long limit = tlb_calibrate_limit(SBI_TLB_FENCE_S);
+
+	tlb_range_flush_limit[SBI_TLB_FENCE_S] = limit;
+	if (misa_extension('H')) {
+		tlb_range_flush_limit[SBI_TLB_FENCE_VS] =
+				tlb_calibrate_limit(SBI_TLB_FENCE_VS);
+		tlb_range_flush_limit[SBI_TLB_FENCE_G] =
+				tlb_calibrate_limit(SBI_TLB_FENCE_G);
+	} else {
+		tlb_range_flush_limit[SBI_TLB_FENCE_VS] = limit;
+		tlb_range_flush_limit[SBI_TLB_FENCE_G] = limit;
+	}
+}
+
 int sbi_tlb_request(ulong hmask, ulong hbase, struct sbi_tlb_info *tinfo)
 {
-	if (!tinfo->local_fn)
+	struct sbi_tlb_info *tlb_slot;
+
+	if (SBI_TLB_TYPE_MAX <= tinfo->type)
 		return SBI_EINVAL;
 
-	tlb_pmu_incr_fw_ctr(tinfo);
+	sbi_pmu_ctr_incr_fw(tlb_fw_sent[tinfo->type]);
+
+	/*
+	 * If address range to flush is too big then simply
+	 * upgrade it to flush all because we can only flush
+	 * 4KB at a time.
+	 */
+	if (tinfo->size > tlb_range_flush_limit[tlb_fence_type(tinfo)]) {
+		tinfo->start = 0;
+		tinfo->size = SBI_TLB_FLUSH_ALL;
+	}
+
+	/*
+	 * Publish the request in our own slot. Remote harts read it
+	 * from there so it must stay untouched until all of them have
+	 * completed, which is guaranteed by the sync callback called
+	 * once after all IPIs are sent.
+	 */
+	tlb_slot = sbi_scratch_thishart_offset_ptr(tlb_slot_off);
+	sbi_memcpy(tlb_slot, tinfo, sizeof(*tlb_slot));
 
-	return sbi_ipi_send_many(hmask, hbase, tlb_event, tinfo);
+	return sbi_ipi_send_many(hmask, hbase, tlb_event, tlb_slot);
 }
 
 int sbi_tlb_init(struct sbi_scratch *scratch, bool cold_boot)
 {
 	int ret;
-	void *tlb_mem;
-	unsigned long *tlb_sync;
-	struct sbi_fifo *tlb_q;
+	u64 limit;
+	u32 type;
+	atomic_t *tlb_sync;
+	struct sbi_hartmask *tlb_pending;
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
 
 	if (cold_boot) {
 		tlb_sync_off = sbi_scratch_alloc_offset(sizeof(*tlb_sync));
 		if (!tlb_sync_off)
 			return SBI_ENOMEM;
-		tlb_fifo_off = sbi_scratch_alloc_offset(sizeof(*tlb_q));
-		if (!tlb_fifo_off) {
+		tlb_pending_off = sbi_scratch_alloc_offset(sizeof(*tlb_pending));
+		if (!tlb_pending_off) {
 			sbi_scratch_free_offset(tlb_sync_off);
 			return SBI_ENOMEM;
 		}
-		tlb_fifo_mem_off = sbi_scratch_alloc_offset(
-				SBI_TLB_FIFO_NUM_ENTRIES * SBI_TLB_INFO_SIZE);
-		if (!tlb_fifo_mem_off) {
-			sbi_scratch_free_offset(tlb_fifo_off);
+		tlb_slot_off = sbi_scratch_alloc_offset(SBI_TLB_INFO_SIZE);
+		if (!tlb_slot_off) {
+			sbi_scratch_free_offset(tlb_pending_off);
 			sbi_scratch_free_offset(tlb_sync_off);
 			return SBI_ENOMEM;
 		}
 		ret = sbi_ipi_event_create(&tlb_ops);
 		if (ret < 0) {
-			sbi_scratch_free_offset(tlb_fifo_mem_off);
-			sbi_scratch_free_offset(tlb_fifo_off);
+			sbi_scratch_free_offset(tlb_slot_off);
+			sbi_scratch_free_offset(tlb_pending_off);
 			sbi_scratch_free_offset(tlb_sync_off);
 			return ret;
 		}
 		tlb_event = ret;
-		tlb_range_flush_limit = sbi_platform_tlbr_flush_limit(plat);
+		limit = sbi_platform_tlbr_flush_limit(plat);
+		if (limit == SBI_PLATFORM_TLB_RANGE_FLUSH_LIMIT_CALIBRATE) {
+			tlb_calibrate();
+		} else {
+			for (type = 0; type < SBI_TLB_FENCE_MAX; type++)
+				tlb_range_flush_limit[type] = limit;
+		}
 	} else {
 		if (!tlb_sync_off ||
-		    !tlb_fifo_off ||
-		    !tlb_fifo_mem_off)
+		    !tlb_pending_off ||
+		    !tlb_slot_off)
 			return SBI_ENOMEM;
 		if (SBI_IPI_EVENT_MAX <= tlb_event)
 			return SBI_ENOSPC;
 	}
 
 	tlb_sync = sbi_scratch_offset_ptr(scratch, tlb_sync_off);
-	tlb_q = sbi_scratch_offset_ptr(scratch, tlb_fifo_off);
-	tlb_mem = sbi_scratch_offset_ptr(scratch, tlb_fifo_mem_off);
-
-	*tlb_sync = 0;
+	tlb_pending = sbi_scratch_offset_ptr(scratch, tlb_pending_off);
 
-	sbi_fifo_init(tlb_q, tlb_mem,
-		      SBI_TLB_FIFO_NUM_ENTRIES, SBI_TLB_INFO_SIZE);
+	ATOMIC_INIT(tlb_sync, 0);
+	SBI_HARTMASK_INIT(tlb_pending);
 
 	return 0;
 }
@@ -209,21 +209,22 @@ int sbi_trap_redirect(struct sbi_trap_regs *regs,
  * 6. Stack pointer (SP) is setup for current HART
  * 7. Interrupts are disabled in MSTATUS CSR
  *
+ * For M-mode timer/software interrupts and the SBI TIME set_timer
+ * call the firmware may save only the caller saved registers in
+ * the register state, so these paths must not touch the others.
+ *
  * @param regs pointer to register state
  */
 struct sbi_trap_regs *sbi_trap_handler(struct sbi_trap_regs *regs)
 {
 	int rc = SBI_ENOTSUPP;
 	const char *msg = "trap handler failed";
+	unsigned long prof = sbi_pmu_prof_begin();
 	ulong mcause = csr_read(CSR_MCAUSE);
-	ulong mtval = csr_read(CSR_MTVAL), mtval2 = 0, mtinst = 0;
+	ulong mtval = 0, mtval2 = 0, mtinst = 0;
 	struct sbi_trap_info trap;
 
-	if (misa_extension('H')) {
-		mtval2 = csr_read(CSR_MTVAL2);
-		mtinst = csr_read(CSR_MTINST);
-	}
-
+	/* Interrupts don't need any other trap CSR so handle them first */
 	if (mcause & (1UL << (__riscv_xlen - 1))) {
 		mcause &= ~(1UL << (__riscv_xlen - 1));
 		switch (mcause) {
@@ -234,12 +235,21 @@ struct sbi_trap_regs *sbi_trap_handler(struct sbi_trap_regs *regs)
 			sbi_ipi_process();
 			break;
 		default:
+			mtval = csr_read(CSR_MTVAL);
 			msg = "unhandled external interrupt";
 			goto trap_error;
 		};
+		sbi_pmu_prof_end(SBI_PMU_FW_TRAP_CYCLES,
+				 mcause | (1UL << (__riscv_xlen - 1)), prof);
 		return regs;
 	}
 
+	mtval = csr_read(CSR_MTVAL);
+	if (misa_extension('H')) {
+		mtval2 = csr_read(CSR_MTVAL2);
+		mtinst = csr_read(CSR_MTINST);
+	}
+
 	switch (mcause) {
 	case CAUSE_ILLEGAL_INSTRUCTION:
 		rc  = sbi_illegal_insn_handler(mtval, regs);
@@ -277,6 +287,7 @@ struct sbi_trap_regs *sbi_trap_handler(struct sbi_trap_regs *regs)
 trap_error:
 	if (rc)
 		sbi_trap_error(msg, rc, mcause, mtval, mtval2, mtinst, regs);
+	sbi_pmu_prof_end(SBI_PMU_FW_TRAP_CYCLES, mcause, prof);
 	return regs;
 }
 
@@ -114,6 +114,170 @@ void sbi_store_u64(u64 *addr, u64 val,
 }
 #endif
 
+/*
+ * The bulk accessors below perform the whole access inside a single MPRV
+ * window using the largest naturally aligned chunks. Nothing except the
+ * target address may be accessed while MPRV is set, so the value is kept
+ * in registers. The expected trap handler clobbers a4 which is cleared
+ * before every access, hence a non-zero a4 after an access means it has
+ * trapped and the loop is terminated right away.
+ */
+ulong sbi_load_bytes(ulong addr, ulong len, struct sbi_trap_info *trap)
+{
+	register ulong tinfo asm("a3");
+	register ulong ttmp asm("a4");
+	register ulong mstatus = 0;
+	register ulong mtvec = sbi_hart_expected_trap_addr();
+	ulong val = 0, shift = 0, tmp;
+
+	trap->cause = 0;
+	if (len > sizeof(ulong))
+		len = sizeof(ulong);
+
+	asm volatile(
+	    "add %[tinfo], %[taddr], zero\n"
+	    "csrrw %[mtvec], " STR(CSR_MTVEC) ", %[mtvec]\n"
+	    "csrrs %[mstatus], " STR(CSR_MSTATUS) ", %[mprv]\n"
+	    ".option push\n"
+	    ".option norvc\n"
+	    "1: beq %[len], zero, 9f\n"
+	    "andi %[tmp], %[addr], 1\n"
+	    "bne %[tmp], zero, 5f\n"
+	    "sltiu %[tmp], %[len], 2\n"
+	    "bne %[tmp], zero, 5f\n"
+	    "andi %[tmp], %[addr], 2\n"
+	    "bne %[tmp], zero, 4f\n"
+	    "sltiu %[tmp], %[len], 4\n"
+	    "bne %[tmp], zero, 4f\n"
+#if __riscv_xlen == 64
+	    "andi %[tmp], %[addr], 4\n"
+	    "bne %[tmp], zero, 3f\n"
+	    "sltiu %[tmp], %[len], 8\n"
+	    "bne %[tmp], zero, 3f\n"
+	    "add %[ttmp], zero, zero\n"
+	    "ld %[tmp], (%[addr])\n"
+	    "bne %[ttmp], zero, 9f\n"
+	    "add %[val], %[tmp], zero\n"
+	    "add %[len], zero, zero\n"
+	    "j 9f\n"
+	    "3: add %[ttmp], zero, zero\n"
+	    "lwu %[tmp], (%[addr])\n"
+#else
+	    "add %[ttmp], zero, zero\n"
+	    "lw %[tmp], (%[addr])\n"
+#endif
+	    "bne %[ttmp], zero, 9f\n"
+	    "sll %[tmp], %[tmp], %[shift]\n"
+	    "or %[val], %[val], %[tmp]\n"
+	    "addi %[addr], %[addr], 4\n"
+	    "addi %[len], %[len], -4\n"
+	    "addi %[shift], %[shift], 32\n"
+	    "j 1b\n"
+	    "4: add %[ttmp], zero, zero\n"
+	    "lhu %[tmp], (%[addr])\n"
+	    "bne %[ttmp], zero, 9f\n"
+	    "sll %[tmp], %[tmp], %[shift]\n"
+	    "or %[val], %[val], %[tmp]\n"
+	    "addi %[addr], %[addr], 2\n"
+	    "addi %[len], %[len], -2\n"
+	    "addi %[shift], %[shift], 16\n"
+	    "j 1b\n"
+	    "5: add %[ttmp], zero, zero\n"
+	    "lbu %[tmp], (%[addr])\n"
+	    "bne %[ttmp], zero, 9f\n"
+	    "sll %[tmp], %[tmp], %[shift]\n"
+	    "or %[val], %[val], %[tmp]\n"
+	    "addi %[addr], %[addr], 1\n"
+	    "addi %[len], %[len], -1\n"
+	    "addi %[shift], %[shift], 8\n"
+	    "j 1b\n"
+	    ".option pop\n"
+	    "9: csrw " STR(CSR_MSTATUS) ", %[mstatus]\n"
+	    "csrw " STR(CSR_MTVEC) ", %[mtvec]"
+	    : [mstatus] "+&r"(mstatus), [mtvec] "+&r"(mtvec),
+	      [tinfo] "+&r"(tinfo), [ttmp] "+&r"(ttmp),
+	      [addr] "+&r"(addr), [len] "+&r"(len), [val] "+&r"(val),
+	      [shift] "+&r"(shift), [tmp] "=&r"(tmp)
+	    : [mprv] "r"(MSTATUS_MPRV), [taddr] "r"((ulong)trap)
+	    : "memory");
+
+	return (trap->cause) ? 0 : val;
+}
+
+void sbi_store_bytes(ulong addr, ulong val, ulong len,
+		     struct sbi_trap_info *trap)
+{
+	register ulong tinfo asm("a3");
+	register ulong ttmp asm("a4");
+	register ulong mstatus = 0;
+	register ulong mtvec = sbi_hart_expected_trap_addr();
+	ulong tmp;
+
+	trap->cause = 0;
+	if (len > sizeof(ulong))
+		len = sizeof(ulong);
+
+	asm volatile(
+	    "add %[tinfo], %[taddr], zero\n"
+	    "csrrw %[mtvec], " STR(CSR_MTVEC) ", %[mtvec]\n"
+	    "csrrs %[mstatus], " STR(CSR_MSTATUS) ", %[mprv]\n"
+	    ".option push\n"
+	    ".option norvc\n"
+	    "1: beq %[len], zero, 9f\n"
+	    "andi %[tmp], %[addr], 1\n"
+	    "bne %[tmp], zero, 5f\n"
+	    "sltiu %[tmp], %[len], 2\n"
+	    "bne %[tmp], zero, 5f\n"
+	    "andi %[tmp], %[addr], 2\n"
+	    "bne %[tmp], zero, 4f\n"
+	    "sltiu %[tmp], %[len], 4\n"
+	    "bne %[tmp], zero, 4f\n"
+#if __riscv_xlen == 64
+	    "andi %[tmp], %[addr], 4\n"
+	    "bne %[tmp], zero, 3f\n"
+	    "sltiu %[tmp], %[len], 8\n"
+	    "bne %[tmp], zero, 3f\n"
+	    "add %[ttmp], zero, zero\n"
+	    "sd %[val], (%[addr])\n"
+	    "j 9f\n"
+	    "3: add %[ttmp], zero, zero\n"
+	    "sw %[val], (%[addr])\n"
+	    "bne %[ttmp], zero, 9f\n"
+	    "srli %[val], %[val], 32\n"
+#else
+	    "add %[ttmp], zero, zero\n"
+	    "sw %[val], (%[addr])\n"
+	    "bne %[ttmp], zero, 9f\n"
+	    "add %[val], zero, zero\n"
+#endif
+	    "addi %[addr], %[addr], 4\n"
+	    "addi %[len], %[len], -4\n"
+	    "j 1b\n"
+	    "4: add %[ttmp], zero, zero\n"
+	    "sh %[val], (%[addr])\n"
+	    "bne %[ttmp], zero, 9f\n"
+	    "srli %[val], %[val], 16\n"
+	    "addi %[addr], %[addr], 2\n"
+	    "addi %[len], %[len], -2\n"
+	    "j 1b\n"
+	    "5: add %[ttmp], zero, zero\n"
+	    "sb %[val], (%[addr])\n"
+	    "bne %[ttmp], zero, 9f\n"
+	    "srli %[val], %[val], 8\n"
+	    "addi %[addr], %[addr], 1\n"
+	    "addi %[len], %[len], -1\n"
+	    "j 1b\n"
+	    ".option pop\n"
+	    "9: csrw " STR(CSR_MSTATUS) ", %[mstatus]\n"
+	    "csrw " STR(CSR_MTVEC) ", %[mtvec]"
+	    : [mstatus] "+&r"(mstatus), [mtvec] "+&r"(mtvec),
+	      [tinfo] "+&r"(tinfo), [ttmp] "+&r"(ttmp),
+	      [addr] "+&r"(addr), [len] "+&r"(len), [val] "+&r"(val),
+	      [tmp] "=&r"(tmp)
+	    : [mprv] "r"(MSTATUS_MPRV), [taddr] "r"((ulong)trap)
+	    : "memory");
+}
+
 ulong sbi_get_insn(ulong mepc, struct sbi_trap_info *trap)
 {
 	register ulong tinfo asm("a3");
@@ -12,20 +12,71 @@
 #include <sbi/sbi_domain.h>
 #include <sbi/sbi_math.h>
 #include <sbi/sbi_hart.h>
+#include <sbi/sbi_init.h>
+#include <sbi/sbi_platform.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_string.h>
 #include <sbi_utils/fdt/fdt_fixup.h>
 #include <sbi_utils/fdt/fdt_pmu.h>
 #include <sbi_utils/fdt/fdt_helper.h>
 
+static bool fdt_cpu_isa_has_ext(const char *isa, const char *ext)
+{
+	size_t len = sbi_strlen(ext);
+	const char *pos = sbi_strchr(isa, '_');
+
+	/* Multi-letter extensions follow the base ISA separated by '_' */
+	while (pos) {
+		pos++;
+		if (!sbi_strncmp(pos, ext, len) &&
+		    (pos[len] == '_' || pos[len] == '\0'))
+			return TRUE;
+		pos = sbi_strchr(pos, '_');
+	}
+
+	return FALSE;
+}
+
+static void fdt_cpu_isa_fixup(void *fdt, int cpu_offset)
+{
+	int len;
+	char isa[256];
+	const char *prop;
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+
+	/*
+	 * Advertise Sstc enabled by OpenSBI so that S-mode programs
+	 * stimecmp directly. Only the boot HART has detected its features
+	 * at this point so all HARTs are assumed to match it, which does
+	 * not hold on heterogeneous platforms.
+	 */
+	if (sbi_platform_has_heterogeneous_harts(sbi_platform_ptr(scratch)) ||
+	    !sbi_hart_has_feature(scratch, SBI_HART_HAS_SSTC))
+		return;
+
+	prop = fdt_getprop(fdt, cpu_offset, "riscv,isa", &len);
+	if (!prop || len <= 0 || fdt_cpu_isa_has_ext(prop, "sstc"))
+		return;
+	if (sizeof(isa) < sbi_strnlen(prop, len) + sizeof("_sstc"))
+		return;
+
+	sbi_strncpy(isa, prop, sizeof(isa));
+	sbi_strcpy(isa + sbi_strlen(isa), "_sstc");
+	fdt_setprop_string(fdt, cpu_offset, "riscv,isa", isa);
+}
+
 void fdt_cpu_fixup(void *fdt)
 {
 	struct sbi_domain *dom = sbi_domain_thishart_ptr();
+	const struct sbi_platform *plat =
+			sbi_platform_ptr(sbi_scratch_thishart_ptr());
 	int err, cpu_offset, cpus_offset, len;
 	const char *mmu_type;
 	u32 hartid;
 
-	err = fdt_open_into(fdt, fdt, fdt_totalsize(fdt) + 32);
+	/* Leave room for the ISA string of every HART to grow as well */
+	err = fdt_open_into(fdt, fdt, fdt_totalsize(fdt) + 32 +
+			    8 * sbi_platform_hart_count(plat));
 	if (err < 0)
 		return;
 
@@ -49,6 +100,8 @@ void fdt_cpu_fixup(void *fdt)
 		    !mmu_type || !len)
 			fdt_setprop_string(fdt, cpu_offset, "status",
 					   "disabled");
+		else
+			fdt_cpu_isa_fixup(fdt, cpu_offset);
 	}
 }
 
@@ -80,6 +133,32 @@ void fdt_plic_fixup(void *fdt)
 	}
 }
 
+void fdt_aclint_sswi_fixup(void *fdt)
+{
+	int err, noff = 0;
+
+	/*
+	 * SSWI devices without "opensbi,smode-access" are protected from
+	 * S-mode by PMP so S-mode drivers must not probe them.
+	 */
+	while (1) {
+		noff = fdt_node_offset_by_compatible(fdt, noff,
+						     "riscv,aclint-sswi");
+		if (noff < 0)
+			break;
+
+		if (fdt_getprop(fdt, noff, "opensbi,smode-access", NULL))
+			continue;
+
+		/* Room for a new "status" property */
+		err = fdt_open_into(fdt, fdt, fdt_totalsize(fdt) + 32);
+		if (err < 0)
+			return;
+
+		fdt_setprop_string(fdt, noff, "status", "disabled");
+	}
+}
+
 static int fdt_resv_memory_update_node(void *fdt, unsigned long addr,
 				       unsigned long size, int index,
 				       int parent, bool no_map)
@@ -259,12 +338,64 @@ int fdt_reserved_memory_nomap_fixup(void *fdt)
 	return 0;
 }
 
+int fdt_boot_trace_fixup(void *fdt)
+{
+	/* Hartid cell followed by a 64-bit stamp for each phase */
+	fdt32_t trace[1 + 2 * SBI_BOOT_PHASE_MAX];
+	u32 i, hartid = current_hartid();
+	int err, names_len = 0, chosen_offset;
+	const char *name;
+	char *names;
+	u64 stamp;
+
+	/*
+	 * Only the trace of the calling coldboot HART is complete and
+	 * stable here, other HARTs may still be writing theirs.
+	 */
+	if (!sbi_init_boot_phase_stamp(hartid, SBI_BOOT_PHASE_ENTRY))
+		return 0;
+
+	trace[0] = cpu_to_fdt32(hartid);
+	for (i = 0; i < SBI_BOOT_PHASE_MAX; i++) {
+		stamp = sbi_init_boot_phase_stamp(hartid, i);
+		trace[1 + 2 * i] = cpu_to_fdt32(stamp >> 32);
+		trace[2 + 2 * i] = cpu_to_fdt32((u32)stamp);
+		names_len += sbi_strlen(sbi_init_boot_phase_name(i)) + 1;
+	}
+
+	err = fdt_open_into(fdt, fdt, fdt_totalsize(fdt) + 128 +
+			    sizeof(trace) + names_len);
+	if (err < 0)
+		return err;
+
+	chosen_offset = fdt_path_offset(fdt, "/chosen");
+	if (chosen_offset < 0)
+		return chosen_offset;
+
+	err = fdt_setprop_placeholder(fdt, chosen_offset,
+				      "opensbi,boot-trace-phases",
+				      names_len, (void **)&names);
+	if (err < 0)
+		return err;
+
+	for (i = 0; i < SBI_BOOT_PHASE_MAX; i++) {
+		name = sbi_init_boot_phase_name(i);
+		sbi_strcpy(names, name);
+		names += sbi_strlen(name) + 1;
+	}
+
+	return fdt_setprop(fdt, chosen_offset, "opensbi,boot-trace",
+			   trace, sizeof(trace));
+}
+
 void fdt_fixups(void *fdt)
 {
 	fdt_plic_fixup(fdt);
+	fdt_aclint_sswi_fixup(fdt);
 
 	fdt_reserved_memory_fixup(fdt);
 	fdt_pmu_fixup(fdt);
+	fdt_boot_trace_fixup(fdt);
 }
 
 
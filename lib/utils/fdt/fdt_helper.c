@@ -14,6 +14,7 @@
 #include <sbi/sbi_scratch.h>
 #include <sbi_utils/fdt/fdt_helper.h>
 #include <sbi_utils/irqchip/plic.h>
+#include <sbi_utils/sys/die_topology.h>
 
 #define DEFAULT_UART_FREQ		0
 #define DEFAULT_UART_BAUD		115200
@@ -213,6 +214,24 @@ int fdt_get_node_addr_size(void *fdt, int node, int index,
 	return 0;
 }
 
+bool fdt_node_is_enabled(void *fdt, int nodeoff)
+{
+	int len;
+	const void *prop;
+
+	prop = fdt_getprop(fdt, nodeoff, "status", &len);
+	if (!prop)
+		return TRUE;
+
+	if (!strncmp(prop, "okay", strlen("okay")))
+		return TRUE;
+
+	if (!strncmp(prop, "ok", strlen("ok")))
+		return TRUE;
+
+	return FALSE;
+}
+
 int fdt_parse_hart_id(void *fdt, int cpu_offset, u32 *hartid)
 {
 	int len;
@@ -269,6 +288,75 @@ int fdt_parse_max_hart_id(void *fdt, u32 *max_hartid)
 	return 0;
 }
 
+/*
+ * Disabled cpu nodes are skipped, so the index of a HART is its position
+ * among the enabled HARTs of its die in ascending hartid order. This also
+ * holds without numa-node-id, where the die comes from the fixed layout.
+ */
+int fdt_parse_die_topology(void *fdt, u32 first_die, u32 harts_per_die,
+			   struct die_topology *topo)
+{
+	int len, err, cpu_offset, cpus_offset;
+	u32 hartid, die, die_hart_count[DIE_TOPOLOGY_MAX_DIES];
+	struct sbi_hartmask harts;
+	const fdt32_t *val;
+
+	if (!fdt || !topo || DIE_TOPOLOGY_MAX_DIES <= first_die)
+		return SBI_EINVAL;
+
+	cpus_offset = fdt_path_offset(fdt, "/cpus");
+	if (cpus_offset < 0)
+		return cpus_offset;
+
+	topo->die_mask = 0;
+	sbi_hartmask_clear_all(&harts);
+	fdt_for_each_subnode(cpu_offset, fdt, cpus_offset) {
+		err = fdt_parse_hart_id(fdt, cpu_offset, &hartid);
+		if (err)
+			continue;
+
+		if (SBI_HARTMASK_MAX_BITS <= hartid)
+			continue;
+
+		if (!fdt_node_is_enabled(fdt, cpu_offset))
+			continue;
+
+		/*
+		 * The die of a HART is given by its NUMA node. Without it
+		 * the fixed layout of harts_per_die HARTs per die is used,
+		 * never below first_die.
+		 */
+		val = fdt_getprop(fdt, cpu_offset, "numa-node-id", &len);
+		if (val && len >= sizeof(fdt32_t))
+			die = fdt32_to_cpu(*val);
+		else if (harts_per_die && first_die < hartid / harts_per_die)
+			die = hartid / harts_per_die;
+		else
+			die = first_die;
+		if (DIE_TOPOLOGY_MAX_DIES <= die)
+			return SBI_EINVAL;
+
+		topo->hartid2die[hartid] = die;
+		topo->die_mask |= 1UL << die;
+		sbi_hartmask_set_hart(hartid, &harts);
+	}
+
+	/*
+	 * Number the enabled HARTs of each die in ascending hartid order and
+	 * refuse a layout with more HARTs on a die than it can have.
+	 */
+	for (die = 0; die < DIE_TOPOLOGY_MAX_DIES; die++)
+		die_hart_count[die] = 0;
+	sbi_hartmask_for_each_hart(hartid, &harts) {
+		die = topo->hartid2die[hartid];
+		topo->hartid2index[hartid] = die_hart_count[die]++;
+		if (harts_per_die && harts_per_die < die_hart_count[die])
+			return SBI_EINVAL;
+	}
+
+	return 0;
+}
+
 int fdt_parse_timebase_frequency(void *fdt, unsigned long *freq)
 {
 	const fdt32_t *val;
@@ -290,6 +378,34 @@ int fdt_parse_timebase_frequency(void *fdt, unsigned long *freq)
 	return 0;
 }
 
+int fdt_parse_tlb_range_flush_limits(void *fdt, unsigned long *limits,
+				     u32 count)
+{
+	const fdt32_t *val;
+	int i, len, chosen_offset;
+
+	if (!fdt || !limits)
+		return SBI_EINVAL;
+
+	chosen_offset = fdt_path_offset(fdt, "/chosen");
+	if (chosen_offset < 0)
+		return chosen_offset;
+
+	/* One limit in bytes per fence type, zero keeps the current one */
+	val = fdt_getprop(fdt, chosen_offset,
+			  "opensbi,tlb-range-flush-limits", &len);
+	if (len <= 0 || !val)
+		return SBI_ENOENT;
+
+	len = len / sizeof(fdt32_t);
+	for (i = 0; i < len && i < count; i++) {
+		if (val[i])
+			limits[i] = fdt32_to_cpu(val[i]);
+	}
+
+	return 0;
+}
+
 int fdt_parse_gaisler_uart_node(void *fdt, int nodeoffset,
 				struct platform_uart_data *uart)
 {
@@ -501,16 +617,15 @@ int fdt_parse_plic(void *fdt, struct plic_data *plic, const char *compat)
 	return fdt_parse_plic_node(fdt, nodeoffset, plic);
 }
 
-int fdt_parse_aclint_node(void *fdt, int nodeoffset, bool for_timer,
-			  unsigned long *out_addr1, unsigned long *out_size1,
-			  unsigned long *out_addr2, unsigned long *out_size2,
-			  u32 *out_first_hartid, u32 *out_hart_count)
+static int __fdt_parse_aclint_node(void *fdt, int nodeoffset, u32 match_hwirq,
+			unsigned long *out_addr1, unsigned long *out_size1,
+			unsigned long *out_addr2, unsigned long *out_size2,
+			u32 *out_first_hartid, u32 *out_hart_count)
 {
 	const fdt32_t *val;
 	uint64_t reg_addr, reg_size;
 	int i, rc, count, cpu_offset, cpu_intc_offset;
 	u32 phandle, hwirq, hartid, first_hartid, last_hartid, hart_count;
-	u32 match_hwirq = (for_timer) ? IRQ_M_TIMER : IRQ_M_SOFT;
 
 	if (nodeoffset < 0 || !fdt ||
 	    !out_addr1 || !out_size1 ||
@@ -580,6 +695,28 @@ int fdt_parse_aclint_node(void *fdt, int nodeoffset, bool for_timer,
 	return 0;
 }
 
+int fdt_parse_aclint_node(void *fdt, int nodeoffset, bool for_timer,
+			  unsigned long *out_addr1, unsigned long *out_size1,
+			  unsigned long *out_addr2, unsigned long *out_size2,
+			  u32 *out_first_hartid, u32 *out_hart_count)
+{
+	return __fdt_parse_aclint_node(fdt, nodeoffset,
+				       (for_timer) ? IRQ_M_TIMER : IRQ_M_SOFT,
+				       out_addr1, out_size1,
+				       out_addr2, out_size2,
+				       out_first_hartid, out_hart_count);
+}
+
+int fdt_parse_aclint_sswi_node(void *fdt, int nodeoffset,
+			       unsigned long *out_addr,
+			       unsigned long *out_size,
+			       u32 *out_first_hartid, u32 *out_hart_count)
+{
+	return __fdt_parse_aclint_node(fdt, nodeoffset, IRQ_S_SOFT,
+				       out_addr, out_size, NULL, NULL,
+				       out_first_hartid, out_hart_count);
+}
+
 int fdt_parse_compat_addr(void *fdt, uint64_t *addr,
 			  const char *compatible)
 {
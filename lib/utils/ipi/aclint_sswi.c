@@ -0,0 +1,85 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 Beijing ESWIN Computing Technology Co., Ltd.
+ */
+
+#include <sbi/riscv_io.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hartmask.h>
+#include <sbi/sbi_ipi.h>
+#include <sbi_utils/ipi/aclint_sswi.h>
+
+static struct aclint_sswi_data *sswi_hartid2data[SBI_HARTMASK_MAX_BITS];
+
+static void sswi_ipi_send(u32 target_hart)
+{
+	u32 *setssip;
+	struct aclint_sswi_data *sswi;
+
+	if (SBI_HARTMASK_MAX_BITS <= target_hart)
+		return;
+	sswi = sswi_hartid2data[target_hart];
+	if (!sswi)
+		return;
+
+	/*
+	 * Set SSIP of the target HART. It is cleared by S-mode
+	 * through the SIP CSR so there is no ipi_clear.
+	 */
+	setssip = (void *)sswi->addr;
+	writel(1, &setssip[target_hart - sswi->first_hartid]);
+}
+
+static struct sbi_ipi_device aclint_sswi = {
+	.name = "aclint-sswi",
+	.ipi_send = sswi_ipi_send,
+	.ipi_clear = NULL
+};
+
+int aclint_sswi_cold_init(struct aclint_sswi_data *sswi)
+{
+	u32 i;
+	int rc;
+	unsigned long pos, region_size;
+	struct sbi_domain_memregion reg;
+	struct sbi_hartmask harts;
+
+	/* Sanity checks */
+	if (!sswi || (sswi->addr & (ACLINT_SSWI_ALIGN - 1)) ||
+	    (sswi->size < ACLINT_SSWI_SIZE) ||
+	    (sswi->first_hartid >= SBI_HARTMASK_MAX_BITS) ||
+	    (sswi->hart_count > ACLINT_SSWI_MAX_HARTS))
+		return SBI_EINVAL;
+
+	/*
+	 * Protect the SSWI regions in the root domain unless S-mode is
+	 * allowed to send IPIs without going through OpenSBI.
+	 */
+	if (!sswi->smode_access) {
+		for (pos = 0; pos < sswi->size; pos += ACLINT_SSWI_ALIGN) {
+			region_size = ((sswi->size - pos) < ACLINT_SSWI_ALIGN) ?
+				      (sswi->size - pos) : ACLINT_SSWI_ALIGN;
+			sbi_domain_memregion_init(sswi->addr + pos, region_size,
+						  SBI_DOMAIN_MEMREGION_MMIO,
+						  &reg, 0);
+			rc = sbi_domain_root_add_memregion(&reg);
+			if (rc)
+				return rc;
+		}
+	}
+
+	/* Update SSWI hartid table */
+	sbi_hartmask_clear_all(&harts);
+	for (i = 0; i < sswi->hart_count; i++) {
+		if (SBI_HARTMASK_MAX_BITS <= sswi->first_hartid + i)
+			break;
+		sswi_hartid2data[sswi->first_hartid + i] = sswi;
+		sbi_hartmask_set_hart(sswi->first_hartid + i, &harts);
+	}
+
+	sbi_ipi_set_smode_device(&aclint_sswi, &harts);
+
+	return 0;
+}
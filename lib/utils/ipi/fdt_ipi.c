@@ -7,17 +7,25 @@
  *   Anup Patel <anup.patel@wdc.com>
  */
 
+#include <libfdt.h>
+#include <sbi/sbi_console.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi_utils/fdt/fdt_helper.h>
 #include <sbi_utils/ipi/fdt_ipi.h>
 
 extern struct fdt_ipi fdt_ipi_mswi;
+extern struct fdt_ipi fdt_ipi_sswi;
 
 static struct fdt_ipi *ipi_drivers[] = {
 	&fdt_ipi_mswi
 };
 
+/* Optional devices used only for S-mode IPIs, all matches are probed */
+static struct fdt_ipi *ipi_smode_drivers[] = {
+	&fdt_ipi_sswi
+};
+
 static struct fdt_ipi dummy = {
 	.match_table = NULL,
 	.cold_init = NULL,
@@ -67,6 +75,25 @@ static int fdt_ipi_cold_init(void)
 			break;
 	}
 
+	for (pos = 0; pos < array_size(ipi_smode_drivers); pos++) {
+		drv = ipi_smode_drivers[pos];
+
+		noff = -1;
+		while ((noff = fdt_find_match(fdt, noff,
+					drv->match_table, &match)) >= 0) {
+			/*
+			 * These devices are optional and HARTs not covered
+			 * by one use the M-mode IPI device, so a broken node
+			 * is skipped instead of failing the boot.
+			 */
+			rc = drv->cold_init(fdt, noff, match);
+			if (rc && rc != SBI_ENODEV)
+				sbi_printf("%s: %s init failed (error %d)\n",
+					   __func__,
+					   fdt_get_name(fdt, noff, NULL), rc);
+		}
+	}
+
 	return 0;
 }
 
@@ -0,0 +1,60 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 Beijing ESWIN Computing Technology Co., Ltd.
+ */
+
+#include <libfdt.h>
+#include <sbi/sbi_error.h>
+#include <sbi_utils/fdt/fdt_helper.h>
+#include <sbi_utils/ipi/fdt_ipi.h>
+#include <sbi_utils/ipi/aclint_sswi.h>
+
+#define SSWI_MAX_NR			16
+
+static unsigned long sswi_count = 0;
+static struct aclint_sswi_data sswi[SSWI_MAX_NR];
+
+static int ipi_sswi_cold_init(void *fdt, int nodeoff,
+			      const struct fdt_match *match)
+{
+	int rc;
+	struct aclint_sswi_data *ss;
+
+	if (SSWI_MAX_NR <= sswi_count)
+		return SBI_ENOSPC;
+	ss = &sswi[sswi_count];
+
+	rc = fdt_parse_aclint_sswi_node(fdt, nodeoff, &ss->addr, &ss->size,
+					&ss->first_hartid, &ss->hart_count);
+	if (rc)
+		return rc;
+
+	/*
+	 * S-mode of any domain could raise IPIs on HARTs of other domains
+	 * through the device so it is left accessible only on request.
+	 * Otherwise fdt_aclint_sswi_fixup() hides it from S-mode.
+	 */
+	ss->smode_access = fdt_getprop(fdt, nodeoff,
+				       "opensbi,smode-access", NULL) ?
+			   TRUE : FALSE;
+
+	rc = aclint_sswi_cold_init(ss);
+	if (rc)
+		return rc;
+
+	sswi_count++;
+	return 0;
+}
+
+static const struct fdt_match ipi_sswi_match[] = {
+	{ .compatible = "riscv,aclint-sswi" },
+	{ },
+};
+
+struct fdt_ipi fdt_ipi_sswi = {
+	.match_table = ipi_sswi_match,
+	.cold_init = ipi_sswi_cold_init,
+	.warm_init = NULL,
+	.exit = NULL,
+};
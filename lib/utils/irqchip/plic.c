@@ -13,6 +13,7 @@
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_string.h>
 #include <sbi_utils/irqchip/plic.h>
+#include <sbi_utils/sys/die_topology.h>
 
 #define PLIC_PRIORITY_BASE 0x0
 #define PLIC_PENDING_BASE 0x1000
@@ -23,58 +24,54 @@
 
 static void plic_set_priority(struct plic_data *plic, u32 source, u32 val)
 {
-#if ((defined BR2_CHIPLET_2) || ((defined BR2_CHIPLET_1) && (defined BR2_CHIPLET_1_DIE0_AVAILABLE)))
-	volatile void *plic_priority = (void *)plic->addr +
-			PLIC_PRIORITY_BASE + 4 * source;
-	writel(val, plic_priority);
-#endif
-#if ((defined BR2_CHIPLET_2) || ((defined BR2_CHIPLET_1) && (defined BR2_CHIPLET_1_DIE1_AVAILABLE)))
-	volatile void *plic_priority_1 = (void *)(plic->addr + 0x20000000) +
-			PLIC_PRIORITY_BASE + 4 * source;
-	writel(val, plic_priority_1);
-#endif
+	u32 die;
+	unsigned long die_mask = die_topology_die_mask(plic->topo);
+	volatile void *plic_priority;
+
+	/* Every die has its own PLIC so program all of them */
+	for_each_set_bit(die, &die_mask, DIE_TOPOLOGY_MAX_DIES) {
+		plic_priority = (void *)plic->addr +
+				die_topology_die_offset(plic->topo, die) +
+				PLIC_PRIORITY_BASE + 4 * source;
+		writel(val, plic_priority);
+	}
+}
+
+static void *plic_context_die_base(struct plic_data *plic, u32 *cntxid)
+{
+	u32 die;
+
+	if (!plic->topo || !plic->die_context_count)
+		return (void *)plic->addr;
+
+	die = *cntxid / plic->die_context_count;
+	*cntxid = *cntxid % plic->die_context_count;
+
+	return (void *)plic->addr + die_topology_die_offset(plic->topo, die);
 }
 
 void plic_set_thresh(struct plic_data *plic, u32 cntxid, u32 val)
 {
+	volatile void *plic_thresh;
+
 	if (!plic)
 		return;
 
-#if ((defined BR2_CHIPLET_2) || ((defined BR2_CHIPLET_1) && (defined BR2_CHIPLET_1_DIE0_AVAILABLE)))
-	if (0 == (cntxid / 8)) { // die 0
-		volatile void *plic_thresh = (void *)plic->addr +
-			PLIC_CONTEXT_BASE + PLIC_CONTEXT_STRIDE * cntxid;
-		writel(val, plic_thresh);
-	}
-#endif
-#if ((defined BR2_CHIPLET_2) || ((defined BR2_CHIPLET_1) && (defined BR2_CHIPLET_1_DIE1_AVAILABLE)))
-	if (cntxid / 8) { // die 1
-		volatile void *plic_thresh_1 = (void *)(plic->addr + 0x20000000 ) +
-			PLIC_CONTEXT_BASE + PLIC_CONTEXT_STRIDE * (cntxid % 8);
-		writel(val, plic_thresh_1);
-	}
-#endif
+	plic_thresh = plic_context_die_base(plic, &cntxid);
+	plic_thresh += PLIC_CONTEXT_BASE + PLIC_CONTEXT_STRIDE * cntxid;
+	writel(val, plic_thresh);
 }
 
 void plic_set_ie(struct plic_data *plic, u32 cntxid, u32 word_index, u32 val)
 {
+	volatile void *plic_ie;
+
 	if (!plic)
 		return;
 
-#if ((defined BR2_CHIPLET_2) || ((defined BR2_CHIPLET_1) && (defined BR2_CHIPLET_1_DIE0_AVAILABLE)))
-	if (0 == (cntxid / 8)) { // die 0
-		volatile void *plic_ie = (void *)plic->addr +
-			PLIC_ENABLE_BASE + PLIC_ENABLE_STRIDE * cntxid;
-		writel(val, plic_ie + word_index * 4);
-	}
-#endif
-#if ((defined BR2_CHIPLET_2) || ((defined BR2_CHIPLET_1) && (defined BR2_CHIPLET_1_DIE1_AVAILABLE)))
-	if (cntxid / 8) { // die 1
-		volatile void *plic_ie_1 = (void *)( plic->addr + 0x20000000 ) +
-			PLIC_ENABLE_BASE + PLIC_ENABLE_STRIDE * (cntxid % 8);
-		writel(val, plic_ie_1 + word_index * 4);
-	}
-#endif
+	plic_ie = plic_context_die_base(plic, &cntxid);
+	plic_ie += PLIC_ENABLE_BASE + PLIC_ENABLE_STRIDE * cntxid;
+	writel(val, plic_ie + word_index * 4);
 }
 
 int plic_warm_irqchip_init(struct plic_data *plic,
@@ -16,9 +16,12 @@
 #include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_ipi.h>
 #include <sbi/sbi_timer.h>
+#include <sbi_utils/sys/die_topology.h>
 #include <sbi_utils/timer/aclint_mtimer.h>
 
 static struct aclint_mtimer_data *mtimer_hartid2data[SBI_HARTMASK_MAX_BITS];
+static u64 *mtimer_hartid2time[SBI_HARTMASK_MAX_BITS];
+static u64 *mtimer_hartid2timecmp[SBI_HARTMASK_MAX_BITS];
 
 #if __riscv_xlen != 32
 static u64 mtimer_time_rd64(volatile u64 *addr)
@@ -55,84 +58,27 @@ static u64 mtimer_value(void)
 {
 	u32 target_hart = current_hartid();
 	struct aclint_mtimer_data *mt = mtimer_hartid2data[target_hart];
-	u64 *time_val;
 
-#if defined(BR2_CLUSTER_1_CORE) && defined(BR2_CHIPLET_1_DIE1_AVAILABLE) && defined(BR2_CHIPLET_1)
-	if(target_hart >= 1  )
-#else
-	if(target_hart >= 4  )
-#endif
-	{
-		time_val = (void *)mt->mtime_addr + 0x20000000;
-	}
-	else
-	{
-		time_val = (void *)mt->mtime_addr;
-	}
 	/* Read MTIMER Time Value */
-	return mt->time_rd(time_val);
+	return mt->time_rd(mtimer_hartid2time[target_hart]);
 }
 
 static void mtimer_event_stop(void)
 {
 	u32 target_hart = current_hartid();
 	struct aclint_mtimer_data *mt = mtimer_hartid2data[target_hart];
-	u64 *time_cmp ;
 
 	/* Clear MTIMER Time Compare */
-#if defined(BR2_CLUSTER_1_CORE) && defined(BR2_CHIPLET_1_DIE1_AVAILABLE) && defined(BR2_CHIPLET_1)
-	if(target_hart >= 1  )
-	{
-		time_cmp = (void *)(mt->mtimecmp_addr + 0x20000000);
-		mt->time_wr(true, -1ULL,
-				&time_cmp[(target_hart -1) - mt->first_hartid]);
-	}
-#else
-	if(target_hart >= 4  )
-	{
-		time_cmp = (void *)(mt->mtimecmp_addr + 0x20000000);
-		mt->time_wr(true, -1ULL,
-				&time_cmp[(target_hart -4) - mt->first_hartid]);
-	}
-#endif
-	
-	else{
-		time_cmp = (void *)mt->mtimecmp_addr;
-		mt->time_wr(true, -1ULL,
-				&time_cmp[target_hart - mt->first_hartid]);
-
-	}
+	mt->time_wr(true, -1ULL, mtimer_hartid2timecmp[target_hart]);
 }
 
 static void mtimer_event_start(u64 next_event)
 {
 	u32 target_hart = current_hartid();
 	struct aclint_mtimer_data *mt = mtimer_hartid2data[target_hart];
-	u64 *time_cmp;
 
 	/* Program MTIMER Time Compare */
-#if defined(BR2_CLUSTER_1_CORE) && defined(BR2_CHIPLET_1_DIE1_AVAILABLE) && defined(BR2_CHIPLET_1)
-	if(target_hart >= 1  )
-	{
-		time_cmp = (void *)(mt->mtimecmp_addr + 0x20000000);
-		mt->time_wr(true, next_event,
-				&time_cmp[(target_hart - 1) - mt->first_hartid]);
-	} 
-#else
-	if(target_hart >= 4  )
-	{
-		time_cmp = (void *)(mt->mtimecmp_addr + 0x20000000);
-		mt->time_wr(true, next_event,
-				&time_cmp[(target_hart - 4) - mt->first_hartid]);
-	} 
-#endif
-	
-	else{
-		time_cmp = (void *)mt->mtimecmp_addr;
-		mt->time_wr(true, next_event,
-				&time_cmp[target_hart - mt->first_hartid]);
-	}
-
+	mt->time_wr(true, next_event, mtimer_hartid2timecmp[target_hart]);
 }
 
 static struct sbi_timer_device mtimer = {
@@ -154,19 +100,9 @@ void aclint_mtimer_sync(struct aclint_mtimer_data *mt)
 		return;
 
 	reference = mt->time_delta_reference;
-#if defined(BR2_CLUSTER_1_CORE) && defined(BR2_CHIPLET_1_DIE1_AVAILABLE) && defined(BR2_CHIPLET_1)
-	if(target_hart >= 1  )
-#else
-	if(target_hart >= 4  )
-#endif
-	{
-		mt_time_val = (void *)mt->mtime_addr + 0x20000000;
-		ref_time_val = (void *)reference->mtime_addr + 0x20000000;
-	}
-	else{
-		mt_time_val = (void *)mt->mtime_addr;
-		ref_time_val = (void *)reference->mtime_addr;
-	}
+	mt_time_val = mtimer_hartid2time[target_hart];
+	ref_time_val = (void *)reference->mtime_addr +
+		die_topology_hart_offset(reference->topo, target_hart);
 
 	if (!atomic_raw_xchg_ulong(&mt->time_delta_computed, 1)) {
 		v1 = mt->time_rd(mt_time_val);
@@ -191,7 +127,6 @@ void aclint_mtimer_set_reference(struct aclint_mtimer_data *mt,
 
 int aclint_mtimer_warm_init(void)
 {
-	u64 *mt_time_cmp;
 	u32 target_hart = current_hartid();
 	struct aclint_mtimer_data *mt = mtimer_hartid2data[target_hart];
 
@@ -202,20 +137,7 @@ int aclint_mtimer_warm_init(void)
 	aclint_mtimer_sync(mt);
 
 	/* Clear Time Compare */
-#if defined(BR2_CLUSTER_1_CORE) && defined(BR2_CHIPLET_1_DIE1_AVAILABLE) && defined(BR2_CHIPLET_1)
-	if(target_hart >= 1  )
-#else
-	if(target_hart >= 4  )
-#endif
-	{
-		mt_time_cmp = (void *)mt->mtimecmp_addr + 0x20000000;
-	}
-	else
-	{
-		mt_time_cmp = (void *)mt->mtimecmp_addr;
-	}
-	mt->time_wr(true, -1ULL,
-		    &mt_time_cmp[target_hart - mt->first_hartid]);
+	mt->time_wr(true, -1ULL, mtimer_hartid2timecmp[target_hart]);
 
 	return 0;
 }
@@ -249,10 +171,43 @@ static int aclint_mtimer_add_regions(unsigned long addr, unsigned long size)
 	return 0;
 }
 
+static int aclint_mtimer_add_die_regions(struct aclint_mtimer_data *mt,
+					 unsigned long offset)
+{
+	int rc;
+	unsigned long mtime_addr = mt->mtime_addr + offset;
+	unsigned long mtimecmp_addr = mt->mtimecmp_addr + offset;
+
+	if (mtime_addr == (mtimecmp_addr + mt->mtimecmp_size)) {
+		rc = aclint_mtimer_add_regions(mtimecmp_addr,
+					mt->mtime_size + mt->mtimecmp_size);
+		if (rc)
+			return rc;
+	} else if (mtimecmp_addr == (mtime_addr + mt->mtime_size)) {
+		rc = aclint_mtimer_add_regions(mtime_addr,
+					mt->mtime_size + mt->mtimecmp_size);
+		if (rc)
+			return rc;
+	} else {
+		rc = aclint_mtimer_add_regions(mtime_addr,
+						mt->mtime_size);
+		if (rc)
+			return rc;
+
+		rc = aclint_mtimer_add_regions(mtimecmp_addr,
+						mt->mtimecmp_size);
+		if (rc)
+			return rc;
+	}
+
+	return 0;
+}
+
 int aclint_mtimer_cold_init(struct aclint_mtimer_data *mt,
 			    struct aclint_mtimer_data *reference)
 {
-	u32 i;
+	u32 i, die, hartid;
+	unsigned long offset, die_mask;
 	int rc;
 
 	/* Sanity checks */
@@ -263,7 +218,8 @@ int aclint_mtimer_cold_init(struct aclint_mtimer_data *mt,
 	    (mt->mtimecmp_addr & (ACLINT_MTIMER_ALIGN - 1)) ||
 	    (mt->mtimecmp_size & (ACLINT_MTIMER_ALIGN - 1)) ||
 	    (mt->first_hartid >= SBI_HARTMASK_MAX_BITS) ||
-	    (mt->hart_count > ACLINT_MTIMER_MAX_HARTS))
+	    (mt->hart_count > ACLINT_MTIMER_MAX_HARTS) ||
+	    (mt->topo && (mt->topo->die_stride & (ACLINT_MTIMER_ALIGN - 1))))
 		return SBI_EINVAL;
 	if (reference && mt->mtime_freq != reference->mtime_freq)
 		return SBI_EINVAL;
@@ -281,29 +237,25 @@ int aclint_mtimer_cold_init(struct aclint_mtimer_data *mt,
 	}
 #endif
 
-	/* Update MTIMER hartid table */
-	for (i = 0; i < mt->hart_count; i++)
-		mtimer_hartid2data[mt->first_hartid + i] = mt;
-
-	/* Add MTIMER regions to the root domain */
-	if (mt->mtime_addr == (mt->mtimecmp_addr + mt->mtimecmp_size)) {
-		rc = aclint_mtimer_add_regions(mt->mtimecmp_addr,
-					mt->mtime_size + mt->mtimecmp_size);
-		if (rc)
-			return rc;
-	} else if (mt->mtimecmp_addr == (mt->mtime_addr + mt->mtime_size)) {
-		rc = aclint_mtimer_add_regions(mt->mtime_addr,
-					mt->mtime_size + mt->mtimecmp_size);
-		if (rc)
-			return rc;
-	} else {
-		rc = aclint_mtimer_add_regions(mt->mtime_addr,
-						mt->mtime_size);
-		if (rc)
-			return rc;
+	/* Update MTIMER hartid tables with MTIME and MTIMECMP of each HART */
+	for (i = 0; i < mt->hart_count; i++) {
+		hartid = mt->first_hartid + i;
+		if (SBI_HARTMASK_MAX_BITS <= hartid)
+			break;
+		offset = die_topology_hart_offset(mt->topo, hartid);
+		mtimer_hartid2data[hartid] = mt;
+		mtimer_hartid2time[hartid] = (void *)(mt->mtime_addr + offset);
+		mtimer_hartid2timecmp[hartid] =
+			(u64 *)(mt->mtimecmp_addr + offset) +
+			die_topology_hart_index(mt->topo, hartid,
+						mt->first_hartid);
+	}
 
-		rc = aclint_mtimer_add_regions(mt->mtimecmp_addr,
-						mt->mtimecmp_size);
+	/* Add MTIMER regions of each die to the root domain */
+	die_mask = die_topology_die_mask(mt->topo);
+	for_each_set_bit(die, &die_mask, DIE_TOPOLOGY_MAX_DIES) {
+		rc = aclint_mtimer_add_die_regions(mt,
+				die_topology_die_offset(mt->topo, die));
 		if (rc)
 			return rc;
 	}
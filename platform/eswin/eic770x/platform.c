@@ -18,6 +18,7 @@
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_system.h>
 #include <sbi/sbi_timer.h>
+#include <sbi/sbi_tlb.h>
 #include <sbi/riscv_io.h>
 #include <sbi_utils/irqchip/plic.h>
 #include <sbi_utils/serial/uart8250.h>
@@ -27,6 +28,7 @@
 #include <sbi_utils/fdt/fdt_helper.h>
 #include <sbi/riscv_asm.h>
 #include <sbi_utils/fdt/fdt_fixup.h>
+#include <sbi_utils/sys/die_topology.h>
 #include <sbi/sbi_hart.h>
 #include "eic770x_uart.h"
 
@@ -35,15 +37,21 @@
 #ifdef BR2_CHIPLET_1_DIE0_AVAILABLE
 #define EIC770X_HART_COUNT				4
 #define	DIE_REG_OFFSET				0
+#define EIC770X_BOOT_DIE				0
 #else
 #define EIC770X_HART_COUNT				8
 #define	DIE_REG_OFFSET				0x20000000
+#define EIC770X_BOOT_DIE				1
 #endif
 #else //BR2_CHIPLET_2
 #define EIC770X_HART_COUNT				8
 #define	DIE_REG_OFFSET				0
+#define EIC770X_BOOT_DIE				0
 #endif
 
+#define EIC770X_DIE_REG_STRIDE				0x20000000
+#define EIC770X_DIE_HART_COUNT				4
+
 #define EIC770X_ACLINT_MSWI_ADDR			0x2000000
 #define EIC770X_ACLINT_MTIMER_ADDR			0x2000000
 #define EIC770X_ACLINT_MTIMER_FREQ			1000000
@@ -52,6 +60,7 @@
 #define EIC770X_PLIC_ADDR				0xc000000
 #define EIC770X_PLIC_NUM_SOURCES		520
 #define EIC770X_PLIC_NUM_PRIORITIES		7
+#define EIC770X_PLIC_DIE_CONTEXTS		8
 
 #define EIC770X_UART0_ADDR				(0x50900000UL + DIE_REG_OFFSET)
 #define EIC770X_UART2_ADDR				(0x50920000UL + DIE_REG_OFFSET)
@@ -61,8 +70,9 @@
 
 #define EIC770X_UART_CLK       (200000000UL)
 
-/* Full tlb flush always */
-#define EIC770X_TLB_RANGE_FLUSH_LIMIT		0
+/* Measure tlb range flush limits at cold boot */
+#define EIC770X_TLB_RANGE_FLUSH_LIMIT		\
+	SBI_PLATFORM_TLB_RANGE_FLUSH_LIMIT_CALIBRATE
 
 /* system reset register */
 #define EIC770X_SYS_RESET_ADDR	0x51828300UL
@@ -70,9 +80,15 @@
 
 /* clang-format on */
 
+static struct die_topology topo = {
+	.die_stride = EIC770X_DIE_REG_STRIDE,
+};
+
 static struct plic_data plic = {
 	.addr = EIC770X_PLIC_ADDR,
 	.num_src = EIC770X_PLIC_NUM_SOURCES,
+	.topo = &topo,
+	.die_context_count = EIC770X_PLIC_DIE_CONTEXTS,
 };
 
 static struct aclint_mswi_data mswi = {
@@ -80,6 +96,7 @@ static struct aclint_mswi_data mswi = {
         .size = ACLINT_MSWI_SIZE,
         .first_hartid = 0,
         .hart_count = EIC770X_HART_COUNT,
+        .topo = &topo,
 };
 
 static struct aclint_mtimer_data mtimer = {
@@ -93,6 +110,7 @@ static struct aclint_mtimer_data mtimer = {
         .first_hartid = 0,
 	.hart_count = EIC770X_HART_COUNT,
 	.has_64bit_mmio = FALSE,
+	.topo = &topo,
 };
 
 #ifdef BR2_CHIPLET_1
@@ -246,12 +264,38 @@ int eic770x_uart2_init()
 }
 static int eic770x_early_init(bool cold_boot)
 {
-	if (cold_boot)
-		sbi_system_reset_add_device(&eic770x_reset);
+	int rc;
+
+	if (!cold_boot)
+		return 0;
+
+	sbi_system_reset_add_device(&eic770x_reset);
+
+	/* Find the die of each HART before the ACLINT and PLIC are set up */
+	rc = fdt_parse_die_topology(fdt_get_address(), EIC770X_BOOT_DIE,
+				    EIC770X_DIE_HART_COUNT, &topo);
+	if (rc)
+		return rc;
 
 	return 0;
 }
 
+static void eic770x_tlb_limits_init(void *fdt)
+{
+	u32 type;
+	unsigned long limits[SBI_TLB_FENCE_MAX];
+
+	for (type = 0; type < SBI_TLB_FENCE_MAX; type++)
+		limits[type] = sbi_tlb_range_flush_limit(type);
+
+	/* Calibrated limits may be overridden by the device tree */
+	if (fdt_parse_tlb_range_flush_limits(fdt, limits, SBI_TLB_FENCE_MAX))
+		return;
+
+	for (type = 0; type < SBI_TLB_FENCE_MAX; type++)
+		sbi_tlb_set_range_flush_limit(type, limits[type]);
+}
+
 static int eic770x_final_init(bool cold_boot)
 {
 	void *fdt;
@@ -260,6 +304,7 @@ static int eic770x_final_init(bool cold_boot)
 		return 0;
 
 	fdt = sbi_scratch_thishart_arg1_ptr();
+	eic770x_tlb_limits_init(fdt);
 	eic770x_modify_dt(fdt);
 
 	return 0;
@@ -278,6 +323,8 @@ static int eic770x_irqchip_init(bool cold_boot)
 {
 	int rc;
 	u32 hartid = current_hartid();
+	u32 cntx_id = topo.hartid2die[hartid] * EIC770X_PLIC_DIE_CONTEXTS +
+		      2 * topo.hartid2index[hartid];
 
 	if (cold_boot) {
 		rc = plic_cold_irqchip_init(&plic);
@@ -285,7 +332,7 @@ static int eic770x_irqchip_init(bool cold_boot)
 			return rc;
 	}
 
-	return plic_warm_irqchip_init(&plic, 2 * hartid ,2 * hartid + 1);
+	return plic_warm_irqchip_init(&plic, cntx_id, cntx_id + 1);
 }
 
 static int eic770x_ipi_init(bool cold_boot)
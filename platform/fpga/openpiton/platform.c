@@ -69,7 +69,7 @@ static int openpiton_early_init(bool cold_boot)
 {
 	void *fdt;
 	struct platform_uart_data uart_data;
-	struct plic_data plic_data;
+	struct plic_data plic_data = { 0 };
 	unsigned long aclint_freq;
 	uint64_t clint_addr;
 	int rc;